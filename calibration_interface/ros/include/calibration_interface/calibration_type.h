@@ -59,6 +59,9 @@
 
 
 #define NUM_MOVE_TRIES 4
+#define MOVE_TIMEOUT 10.0			// [s] max. time for a camera or arm to reach its target configuration
+#define MOVE_TOLERANCE 0.025		// euclidean distance to the target configuration at which a motion counts as completed
+#define JOINT_STATE_TIMEOUT 2.0		// [s] max. time to wait for the first joint state of a camera or arm
 
 enum MoveErrorCode
 {
@@ -69,24 +72,64 @@ enum MoveErrorCode
 
 
 class IPAInterface;  // forward declaration
+class JointStateMonitor;
 
 struct camera_description
 {
 	std::string camera_name_;
 	int dof_count_;
 	double max_delta_angle_;  // in [rad]
+	std::vector<double> joint_speeds_;  // in [rad/s], used to estimate the time for moving between configurations
+	std::string kinematic_chain_;  // see IPAInterface::getKinematicChain()
 	std::vector< std::vector<double> > configurations_;  // wished camera configurations. Can be used to calibrate the whole workspace of the arm.
 };
 
+struct actuator_motion  // a single camera or arm motion, dispatched together with the other actuators by moveActuators()
+{
+	std::string name_;
+	bool is_arm_;
+	int device_index_;  // index in cameras_ or arms_
+	const std::vector<double>* configuration_;  // target configuration
+	JointStateMonitor* state_;
+	std::string chain_;  // kinematic chain the actuator moves, see IPAInterface::getKinematicChain()
+	unsigned short error_code_;
+	short tries_;
+	bool finished_;
+
+	actuator_motion() : is_arm_(false), device_index_(-1), configuration_(0), state_(0), error_code_(MOV_NO_ERR), tries_(0), finished_(false) {}
+};
+
 class CalibrationType
 {
 
 protected:
 
 	virtual bool moveCameras(int config_index) = 0;  // determines when and how cameras will be moved, the actual movement however is done in moveCamera(). Has to be implemented in child classes
-	unsigned short moveCamera(const camera_description &camera, const std::vector<double> &cam_configuration);
+	unsigned short moveCamera(const camera_description &camera, const std::vector<double> &cam_configuration);  // blocks until the camera reached its goal
+	unsigned short startCameraMotion(const camera_description &camera, const std::vector<double> &cam_configuration, JointStateMonitor* camera_state);  // only dispatches the goal
+	unsigned short waitForMotion(const std::string &name, JointStateMonitor* state, const std::vector<double> &configuration);
+
+	// configuration a camera has in configuration config_index, also if the camera is not moved for it. moveCameras() commands every
+	// camera to it and getConfigurationParameters() reports it, so configurations can be visited in any order. 0 if there is none
+	virtual const std::vector<double>* getCameraConfiguration(int config_index, int camera_index) const;
+
+	// moves independent actuators concurrently while keeping NUM_MOVE_TRIES retries per actuator, throws on fatal errors
+	void addCameraMotions(int config_index, std::vector<actuator_motion> &motions);
+	virtual unsigned short startMotion(const actuator_motion &motion);
+	bool moveActuators(std::vector<actuator_motion> &motions);
 	bool generateConfigs(const std::vector< std::vector<double> > &param_vector, std::vector< std::vector<double> > &configs);
 	bool passesMaxDeltaAngleCheck(const std::vector<double> &state, const std::vector<double> &target, const double max_angle, int &bad_idx);
+	void readJointSpeeds(const std::string &name, const int dof_count, std::vector<double> &joint_speeds);  // reads <name>_joint_speeds, defaults to 1 rad/s per joint
+
+	// time [s] to move from one configuration to another, parameters as returned by getConfigurationParameters()
+	virtual double getTransitionTime(const std::vector<double> &from, const std::vector<double> &to) = 0;
+
+	// time one device needs for its joints [offset, offset+joint_speeds.size()), joints move simultaneously. transitions that
+	// exceed max_delta_angle would be refused by the device and are penalized instead
+	double getJointTransitionTime(const std::vector<double> &from, const std::vector<double> &to, const int offset, const std::vector<double> &joint_speeds, const double max_delta_angle);
+
+	// orders the configurations (nearest neighbour tour improved by 2-opt) to minimize the total transition time, call once max_configuration_count is known
+	void scheduleConfigurations();
 
 
 	ros::NodeHandle node_handle_;
@@ -100,6 +143,8 @@ protected:
 
     bool initialized_;  // set this in child class once everything has initialized
 
+    std::vector<int> configuration_order_;  // scheduled position -> configuration index, empty if configurations are visited in given order
+
 
 public:
 
@@ -110,6 +155,9 @@ public:
 	virtual bool moveRobot(int config_index);
 	virtual std::string getString() = 0;
 	int getConfigurationCount();
+	int getScheduledIndex(int config_index) const;  // maps the config_index-th visited configuration onto the configuration index used by moveRobot()
+	virtual bool getConfigurationParameters(int config_index, std::vector<double> &parameters) = 0;  // joint/pose values the robot is moved to in a configuration
+	bool isTransitionFeasible(int from_index, int to_index);  // false if a device would refuse the transition due to its max delta angle
 	void getUncertainties(std::vector<std::string> &uncertainties_list);
 };
 
@@ -60,6 +60,8 @@ struct arm_description
 	std::string arm_name_;
 	int dof_count_;
 	double max_delta_angle_;  // in [rad]
+	std::vector<double> joint_speeds_;  // in [rad/s], used to estimate the time for moving between configurations
+	std::string kinematic_chain_;  // see IPAInterface::getKinematicChain()
 	std::vector< std::vector<double> > configurations_;  // wished arm configurations used for calibration
 };
 
@@ -73,6 +75,7 @@ public:
 
 	bool moveRobot(int config_index);
 	std::string getString();
+	bool getConfigurationParameters(int config_index, std::vector<double> &parameters);
 
 
 protected:
@@ -80,16 +83,14 @@ protected:
 	void initialize(ros::NodeHandle* nh, IPAInterface* calib_interface);
 
 	bool moveCameras(int config_index);
-	unsigned short moveArm(const arm_description &arm, const std::vector<double>& arm_configuration);
+	unsigned short startArmMotion(const arm_description &arm, const std::vector<double>& arm_configuration, JointStateMonitor* arm_state);  // only dispatches the goal
+	void addArmMotions(int config_index, std::vector<actuator_motion> &motions);
+	const std::vector<double>* getArmConfiguration(int config_index, int arm_index) const;  // like getCameraConfiguration()
+	unsigned short startMotion(const actuator_motion &motion);
+	double getTransitionTime(const std::vector<double> &from, const std::vector<double> &to);
 	std::vector<arm_description> arms_;
 
 
-private:
-
-	int current_arm_index_;  // mapped index that accesses the correct vector element of the base_configurations_ vector
-	int current_camera_index_;  // mapped index that accesses the correct vector element of the currently moved camera
-
-
 };
 
 
@@ -71,12 +71,18 @@ public:
 
 	bool moveRobot(int config_index);
 	std::string getString();
+	bool getConfigurationParameters(int config_index, std::vector<double> &parameters);
 
 
 protected:
 
 	bool moveCameras(int config_index);
+	const std::vector<double>* getCameraConfiguration(int config_index, int camera_index) const;
+
+	// configurations are ordered base by base, at each base location the cameras move one after another through all their configurations
+	bool mapConfigIndex(int config_index, int &base_index, int &camera_index, int &camera_config_index) const;
     unsigned short moveBase(const pose_definition::RobotConfiguration &base_configuration);
+    double getTransitionTime(const std::vector<double> &from, const std::vector<double> &to);
 
     bool isReferenceFrameValid(cv::Mat &T, unsigned short& error_code);  // returns wether reference frame is valid -> if so, it is save to move the robot base, otherwise stop!
     bool divergenceDetectedRotation(double error_phi, bool start_value);  // rotation controller diverges!
@@ -87,6 +93,8 @@ protected:
     double max_ref_frame_distance_;
 
     std::vector<pose_definition::RobotConfiguration> base_configurations_;  // wished base configurations used for calibration
+    double base_linear_speed_;  // [m/s], used to estimate the time for moving between configurations
+    double base_angular_speed_;  // [rad/s]
 
     std::string base_frame_;        // Name of base frame, needed for security measure
     std::string reference_frame_;  // name of reference frame, needed for security measure
@@ -101,11 +109,6 @@ private:
     double start_error_x_;	// Used for divergence detection
     double start_error_y_;	// Used for divergence detection
 
-	int mapped_base_index_;  // mapped index that accesses the correct vector element of the base_configurations_ vector
-	int mapped_camera_index_;  // mapped index that accesses the correct vector element of the currently moved camera
-	int current_camera_counter_;  // used to determine which camera to move
-	bool cameras_done_;  // set when all cameras have iterated through all their configs. used to determine when to move robot's base (every time cameras are done)
-
 
 };
 
@@ -0,0 +1,163 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: June 2018
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#ifndef CHECKERBOARD_DETECTOR_H_
+#define CHECKERBOARD_DETECTOR_H_
+
+
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <tf/tf.h>
+#include <tf/transform_broadcaster.h>
+#include <robotino_calibration/pose_filter.h>
+#include <opencv2/opencv.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/function.hpp>
+#include <string>
+#include <vector>
+
+
+// Detects the checkerboard in the images of one camera and keeps the filtered checkerboard pose.
+// Image callbacks only store the newest frame, the detection itself runs in detect(), which may be called from any thread.
+class CheckerboardDetector
+{
+
+protected:
+
+	ros::NodeHandle node_handle_;  // namespace of this camera's parameters
+	std::string camera_name_;
+
+	std::string camera_frame_;
+	std::string checkerboard_frame_;
+	cv::Size checkerboard_pattern_size_;
+	double checkerboard_cell_size_;
+	int num_distortion_params_;
+	bool use_tracking_;  // search the checkerboard around its last pose before searching the whole image
+	double tracking_roi_padding_;  // padding added to each side of the projected checkerboard, relative to its size
+	int tracking_pyramid_levels_;  // number of times the region of interest is halved before searching corners in it
+	bool ransac_fallback_;  // run solvePnPRansac if the iterative pose exceeds max_reprojection_rms_
+	double max_reprojection_rms_;  // in [px]
+	std::vector<cv::Point3f> pattern_points_3d_;  // checkerboard corners in the checkerboard frame, built once
+
+	ros::Subscriber info_sub_;
+	ros::Publisher reprojection_rms_pub_;  // reprojection RMS [px] of each detected pose, lets consumers gate on quality
+	ros::Publisher pose_pub_;  // filtered checkerboard pose with its covariance
+	image_transport::Subscriber image_sub_;
+	boost::function<void (CheckerboardDetector*)> new_frame_callback_;
+
+	boost::mutex camera_data_mutex_;  // guards intrinsics and the swap of the latest image message, detection runs without holding it
+	sensor_msgs::ImageConstPtr latest_image_msg_;
+	ros::Time latest_image_time_;
+	cv::Mat cam_matrix_;
+	cv::Mat distortion_;
+	bool initialized_;  // intrinsic parameters received
+
+	// only touched by detect()
+	sensor_msgs::ImageConstPtr processed_image_msg_;  // last image the checkerboard has been searched in
+	bool tracking_valid_;  // checkerboard has been found in the last image, last_rvec_ and last_tvec_ hold its raw pose
+	cv::Mat last_rvec_;
+	cv::Mat last_tvec_;
+
+	boost::mutex transform_mutex_;  // guards the filtered checkerboard pose
+	PoseFilter pose_filter_;
+	bool detection_valid_;  // the checkerboard has been found in the newest processed frame
+	ros::Time detection_time_;  // stamp of the image the last detection stems from
+	double converged_std_translation_;  // the checkerboard frame is published to tf once the filter is more certain than this, in [m], has to lie above the steady state std of the detection rate
+	double converged_std_rotation_;  // in [rad]
+
+	// loads a parameter of this camera, falls back to the node wide value if the camera does not define it
+	template<typename T>
+	void loadParameter(ros::NodeHandle &nh, const std::string &name, T &value, const T &default_value);
+
+	// loads a pose filter parameter [translation, rotation] into value[0] and value[1]
+	void loadFilterParameter(ros::NodeHandle &nh, const std::string &name, const double default_translation, const double default_rotation, double* value);
+
+	// finds the checkerboard corners in full image coordinates, searching around the last pose first if tracking is enabled
+	bool findCorners(const cv::Mat &gray, const cv::Mat &cam_matrix, const cv::Mat &distortion, std::vector<cv::Point2f> &corners);
+
+	// projects the outer checkerboard corners of the last pose into the image and pads their bounding box
+	bool getTrackingROI(const cv::Size &image_size, const cv::Mat &cam_matrix, const cv::Mat &distortion, cv::Rect &roi);
+
+	// pose of the checkerboard from its corners, refines the given pose if use_guess is set. rms is the reprojection RMS in [px]
+	bool estimatePose(const std::vector<cv::Point2f> &corners, const cv::Mat &cam_matrix, const cv::Mat &distortion, const bool use_guess,
+					  cv::Mat &rvec, cv::Mat &tvec, double &rms);
+	double computeReprojectionRMS(const std::vector<cv::Point2f> &corners, const cv::Mat &cam_matrix, const cv::Mat &distortion,
+								  const cv::Mat &rvec, const cv::Mat &tvec);
+
+	// records whether the checkerboard has been found in the image with the given stamp
+	void setDetectionValid(const bool valid, const ros::Time &image_time);
+
+	// searches corners in roi of gray, optionally on a downscaled pyramid level, corners are returned in full image coordinates
+	bool searchCorners(const cv::Mat &gray, const cv::Rect &roi, const int pyramid_levels, std::vector<cv::Point2f> &corners);
+
+public:
+
+	// parameters are read from nh/camera_name, or directly from nh if camera_name is empty (single camera setup).
+	// new_frame_callback is called from the image callback whenever a new frame is available for detect()
+	CheckerboardDetector(ros::NodeHandle &nh, image_transport::ImageTransport &it, const std::string &camera_name,
+						 const boost::function<void (CheckerboardDetector*)> &new_frame_callback);
+	~CheckerboardDetector();
+
+	// callbacks
+	void infoCallback(const sensor_msgs::CameraInfoConstPtr& camera_info_msg);
+	void imageCallback(const sensor_msgs::ImageConstPtr& image_msg);
+
+	bool isInitialized();
+	bool detect();  // searches the checkerboard in the newest frame, returns false if there was no new frame to search in
+	void publishTransform(tf::TransformBroadcaster &transform_broadcaster);  // broadcasts the filtered checkerboard pose while it is visible and has converged
+
+	const std::string& getCameraName() const;
+};
+
+
+#endif /* CHECKERBOARD_DETECTOR_H_ */
@@ -82,7 +82,7 @@ public:
 	// camera calibration interface
 	void assignNewRobotVelocity(geometry_msgs::Twist newVelocity);
 	void assignNewCameraAngles(const std::string &camera_name, std_msgs::Float64MultiArray newAngles);
-	std::vector<double>* getCurrentCameraState(const std::string &camera_name);
+	JointStateMonitor* getCameraStateMonitor(const std::string &camera_name);
 
 	// callbacks
 	void cameraStateCallback(const sensor_msgs::JointState::ConstPtr& msg);
@@ -91,7 +91,7 @@ public:
 
 	// arm calibration interface
 	void assignNewArmJoints(const std::string &arm_name, std_msgs::Float64MultiArray newJointConfig);
-	std::vector<double>* getCurrentArmState(const std::string &arm_name);
+	JointStateMonitor* getArmStateMonitor(const std::string &arm_name);
 };
 
 #endif /* COB_INTERFACE_H_ */
@@ -58,6 +58,10 @@
 #include <std_msgs/Float64MultiArray.h>
 #include <std_msgs/Float64.h>
 #include <geometry_msgs/Twist.h>
+#include <sensor_msgs/JointState.h>
+#include <ros/callback_queue.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <vector>
 
 
@@ -70,6 +74,35 @@ enum RobotTypes
 };
 
 
+// Holds the latest joint positions of a camera or an arm. The joint state callbacks write into it and wake up everyone
+// who waits for a motion to complete, so the calibration types neither poll nor copy the state on every tick.
+class JointStateMonitor
+{
+protected:
+
+	boost::mutex mutex_;
+	boost::condition_variable condition_;
+	std::vector<double> positions_;
+	bool valid_;  // true once the first joint state has been received
+
+	double getDeviation(const std::vector<double> &target) const;  // euclidean distance to target, mutex_ must be held
+
+public:
+
+	JointStateMonitor();
+
+	void update(const std::vector<double> &positions);
+	void update(const sensor_msgs::JointState &msg, const std::vector<std::string> &joint_names);  // only picks the given joints, in that order
+
+	// copies the current joint positions into state, waits up to timeout [s] for the first joint state
+	bool getState(std::vector<double> &state, const double timeout);
+
+	// blocks until the euclidean distance between the current joint positions and target drops below tolerance,
+	// returns false if that does not happen within timeout [s], deviation holds the last distance in both cases
+	bool waitForState(const std::vector<double> &target, const double tolerance, const double timeout, double &deviation);
+};
+
+
 class IPAInterface : public CalibrationInterface
 {
 
@@ -80,6 +113,11 @@ protected:
 	bool arm_calibration_;
 	bool load_data_;  // load stored calibration data from disk -> offline calibration
 
+	// joint state callbacks are served by an own spinner thread, so waiting for a motion to complete does not block them
+	ros::CallbackQueue joint_state_queue_;
+	ros::NodeHandle joint_state_node_handle_;  // subscribe all joint state topics with this node handle
+	ros::AsyncSpinner joint_state_spinner_;
+
 
 public:
 
@@ -91,22 +129,30 @@ public:
 
 	bool moveRobot(int config_index);
 	int getConfigurationCount();
+	bool getConfigurationParameters(int config_index, std::vector<double> &parameters);
+	int getScheduledIndex(int config_index);
+	bool isTransitionFeasible(int from_index, int to_index);
 
 	void preSnapshot(int current_index);
+	double getMaxSettleTime();
 	void getPatternPoints3D(const std::string marker_frame, std::vector<cv::Point3f> &pattern_points_3d);
 	void getUncertainties(std::vector<std::string> &uncertainties_list);
 	std::string getFileName(const std::string &appendix, const bool file_extension);
 
 	virtual std::string getRobotName();
 
+	// name of the joints a camera or arm moves. actuators of the same kinematic chain are never moved concurrently,
+	// by default each camera and arm drives joints of its own
+	virtual std::string getKinematicChain(const std::string &actuator_name, const bool is_arm);
+
 	// camera calibration interface
 	virtual void assignNewRobotVelocity(geometry_msgs::Twist newVelocity) = 0;
 	virtual void assignNewCameraAngles(const std::string &camera_name, std_msgs::Float64MultiArray newAngles) = 0;
-	virtual std::vector<double>* getCurrentCameraState(const std::string &camera_name) = 0;
+	virtual JointStateMonitor* getCameraStateMonitor(const std::string &camera_name) = 0;
 
 	// arm calibration interface
 	virtual void assignNewArmJoints(const std::string &arm_name, std_msgs::Float64MultiArray newJointConfig) = 0;
-	virtual std::vector<double>* getCurrentArmState(const std::string &arm_name) = 0;
+	virtual JointStateMonitor* getArmStateMonitor(const std::string &arm_name) = 0;
 };
 
 
@@ -68,8 +68,7 @@ protected:
 	std::string base_controller_topic_name_;
 	ros::Publisher base_controller_;
 
-	sensor_msgs::JointState* camera_state_current_;
-	boost::mutex camera_state_data_mutex_;	// secures read operations on pan tilt joint state data
+	JointStateMonitor camera_state_current_;
 	std::string joint_state_topic_;
 
 	std::string camera_joint_state_topic_;
@@ -78,8 +77,7 @@ protected:
 
 	std::string arm_state_topic_;
 	ros::Subscriber arm_state_;
-	sensor_msgs::JointState* arm_state_current_;
-	boost::mutex arm_state_data_mutex_;	// secures read operations on arm state data
+	JointStateMonitor arm_state_current_;
 	actionlib::SimpleActionClient<control_msgs::FollowJointTrajectoryAction> arm_action_client_;
 
 
@@ -88,11 +86,12 @@ public:
 	~RAWInterface();
 
 	std::string getRobotName();
+	std::string getKinematicChain(const std::string &actuator_name, const bool is_arm);
 
 	// camera calibration interface
 	void assignNewRobotVelocity(geometry_msgs::Twist new_velocity);
 	void assignNewCameraAngles(const std::string &camera_name, std_msgs::Float64MultiArray new_angles);
-	std::vector<double>* getCurrentCameraState(const std::string &camera_name);
+	JointStateMonitor* getCameraStateMonitor(const std::string &camera_name);
 
 	// callbacks
 	void cameraStateCallback(const sensor_msgs::JointState::ConstPtr& msg);
@@ -100,7 +99,7 @@ public:
 
 	// arm calibration interface
 	void assignNewArmJoints(const std::string &arm_name, std_msgs::Float64MultiArray new_joint_config);
-	std::vector<double>* getCurrentArmState(const std::string &arm_name);
+	JointStateMonitor* getArmStateMonitor(const std::string &arm_name);
 };
 
 
@@ -69,15 +69,12 @@ protected:
 
 	ros::Subscriber camera_joint_state_sub_;
 	std::string camera_joint_state_topic_;			// topic name of the topic which contains current camera joint states
-	std::vector<double> camera_state_current_;
-	boost::mutex camera_state_data_mutex_;	// secures read operations on camera joint state data
-	std::string pan_joint_name_;			// name of the pan joint in array of tilt_joint_states_topic_ topic
-	std::string tilt_joint_name_;			// name of the tilt joint in array of tilt_joint_states_topic_ topic
+	JointStateMonitor camera_state_current_;	// [pan, tilt]
+	std::vector<std::string> camera_joint_names_;	// [pan_joint_name, tilt_joint_name], names of the joints in array of camera_joint_state_topic_ topic
 
 	ros::Subscriber arm_state_;
 	std::string arm_state_topic_;
-	sensor_msgs::JointState* arm_state_current_;
-	boost::mutex arm_state_data_mutex_;	// secures read operations on arm joint state data
+	JointStateMonitor arm_state_current_;
 
 public:
 	RobotinoInterface(ros::NodeHandle* nh, CalibrationType* calib_type, CalibrationMarker* calib_marker, bool do_arm_calibration, bool load_data);
@@ -88,7 +85,7 @@ public:
 	// camera calibration interface
 	void assignNewRobotVelocity(geometry_msgs::Twist new_velocity);
 	void assignNewCameraAngles(const std::string &camera_name, std_msgs::Float64MultiArray new_angles);
-	std::vector<double>* getCurrentCameraState(const std::string &camera_name);
+	JointStateMonitor* getCameraStateMonitor(const std::string &camera_name);
 
 	// callbacks
 	void cameraJointStateCallback(const sensor_msgs::JointState::ConstPtr& msg);
@@ -96,7 +93,7 @@ public:
 
 	// arm calibration interface
 	void assignNewArmJoints(const std::string &arm_name, std_msgs::Float64MultiArray new_joint_config);
-	std::vector<double>* getCurrentArmState(const std::string &arm_name);
+	JointStateMonitor* getArmStateMonitor(const std::string &arm_name);
 };
 
 
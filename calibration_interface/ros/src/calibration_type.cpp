@@ -53,6 +53,14 @@
 #include <robotino_calibration/time_utilities.h>
 #include <robotino_calibration/transformation_utilities.h>
 #include <std_msgs/Float64MultiArray.h>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <exception>
+
+
+static const double TRANSITION_PENALTY = 1e4;  // [s] added for transitions a device would refuse due to its max delta angle
+static const int MAX_SCHEDULING_PASSES = 100;  // upper bound for improving the configuration order, only limits the runtime (the result of a pass is deterministic anyway)
 
 
 CalibrationType::CalibrationType() :
@@ -85,6 +93,8 @@ void CalibrationType::initialize(ros::NodeHandle* nh, IPAInterface* calib_interf
 			continue;
 		}
 
+		readJointSpeeds(cam_desc.camera_name_, cam_desc.dof_count_, cam_desc.joint_speeds_);
+		cam_desc.kinematic_chain_ = calibration_interface_->getKinematicChain(cam_desc.camera_name_, false);
 		cameras_.push_back(cam_desc);
 		std::cout << cameras_list[i] << ": DoF " << cameras_list[i+1] << ", max delta angle: " << cameras_list[i+2] << std::endl;
 	}
@@ -238,28 +248,37 @@ bool CalibrationType::moveRobot(int config_index)
 }
 
 unsigned short CalibrationType::moveCamera(const camera_description &camera, const std::vector<double> &cam_configuration)
+{
+	JointStateMonitor* camera_state = calibration_interface_->getCameraStateMonitor(camera.camera_name_);
+
+	unsigned short error_code = startCameraMotion(camera, cam_configuration, camera_state);
+	if ( error_code == MOV_NO_ERR )
+		error_code = waitForMotion(camera.camera_name_, camera_state, cam_configuration);
+
+	return error_code;
+}
+
+unsigned short CalibrationType::startCameraMotion(const camera_description &camera, const std::vector<double> &cam_configuration, JointStateMonitor* camera_state)
 {
 	std_msgs::Float64MultiArray angles;
 	angles.data.resize(cam_configuration.size());
 
-	unsigned short error_code = MOV_NO_ERR;
 	const std::string &camera_name = camera.camera_name_;
 
 	for ( int i=0; i<angles.data.size(); ++i )
 		angles.data[i] = cam_configuration[i];
 
-	ros::spinOnce();
-	std::vector<double> cur_state = *calibration_interface_->getCurrentCameraState(camera_name);
+	std::vector<double> cur_state;
 
-	if ( cur_state.empty() )
+	if ( camera_state == 0 || !camera_state->getState(cur_state, JOINT_STATE_TIMEOUT) || cur_state.empty() )
 	{
-		ROS_ERROR("CalibrationType::moveCamera - Can't retrieve state of current camera %s.", camera_name.c_str());
+		ROS_ERROR("CalibrationType::startCameraMotion - Can't retrieve state of current camera %s.", camera_name.c_str());
 		return MOV_ERR_FATAL;
 	}
 
 	if ( cur_state.size() != cam_configuration.size() )
 	{
-		ROS_ERROR("CalibrationType::moveCamera - Size of target camera configuration and count of camera joints do not match! Please adjust the yaml file.");
+		ROS_ERROR("CalibrationType::startCameraMotion - Size of target camera configuration and count of camera joints do not match! Please adjust the yaml file.");
 		return MOV_ERR_FATAL;
 	}
 
@@ -272,12 +291,12 @@ unsigned short CalibrationType::moveCamera(const camera_description &camera, con
 		{
 			if ( bad_index == -1 )
 			{
-				ROS_ERROR("CalibrationType::moveCamera - Size of target camera configuration and count of camera joints do not match! Please adjust the yaml file.");
+				ROS_ERROR("CalibrationType::startCameraMotion - Size of target camera configuration and count of camera joints do not match! Please adjust the yaml file.");
 				return MOV_ERR_FATAL;
 			}
 			else
 			{
-				ROS_WARN("CalibrationType::moveCamera - Angle number %d in target configuration of camera %s exceeds max allowed deviation %f!\n"
+				ROS_WARN("CalibrationType::startCameraMotion - Angle number %d in target configuration of camera %s exceeds max allowed deviation %f!\n"
 						 "Please move the camera manually closer to the target position to avoid collision issues.", bad_index, camera_name.c_str(), max_delta_angle);
 				std::cout << "Current camera state: ";
 				for ( size_t j=0; j<cur_state.size(); ++j )
@@ -292,41 +311,134 @@ unsigned short CalibrationType::moveCamera(const camera_description &camera, con
 	}
 
 	calibration_interface_->assignNewCameraAngles(camera_name, angles);
+	return MOV_NO_ERR;
+}
+
+unsigned short CalibrationType::waitForMotion(const std::string &name, JointStateMonitor* state, const std::vector<double> &configuration)
+{
+	// wait for camera or arm to arrive at goal, woken up by each new joint state instead of polling it
+	double deviation = 0.;
+	if ( state->waitForState(configuration, MOVE_TOLERANCE, MOVE_TIMEOUT, deviation) )
+		std::cout << name << " configuration reached, deviation: " << deviation << std::endl;
+	else
+	{
+		ROS_WARN("CalibrationType::waitForMotion - Could not reach following configuration of %s in time:", name.c_str());
+		for (int i = 0; i<configuration.size(); ++i)
+			std::cout << configuration[i] << "\t";
+		std::cout << std::endl;
+
+		return MOV_ERR_SOFT;
+	}
 
-	// wait for camera to arrive at goal
-	const double start_time = time_utilities::getSystemTimeSec();
-	while ( time_utilities::getTimeElapsedSec(start_time) < 10.f )
+	return MOV_NO_ERR;
+}
+
+const std::vector<double>* CalibrationType::getCameraConfiguration(int config_index, int camera_index) const
+{
+	const std::vector< std::vector<double> > &configurations = cameras_[camera_index].configurations_;
+	if ( config_index < 0 || configurations.empty() )
+		return 0;
+
+	// cameras that have finished their configurations remain at their last one
+	return &configurations[std::min<int>(config_index, configurations.size()-1)];
+}
+
+void CalibrationType::addCameraMotions(int config_index, std::vector<actuator_motion> &motions)
+{
+	for ( int i=0; i<cameras_.size(); ++i )
 	{
-		ros::Rate(20).sleep(); // No need to iterate through this every tick
-		ros::spinOnce();
-		cur_state = *calibration_interface_->getCurrentCameraState(camera_name);
+		// cameras are also commanded if their configuration does not change, configurations may be visited in any order
+		const std::vector<double>* configuration = getCameraConfiguration(config_index, i);
+		if ( configuration == 0 )
+			continue;
+
+		actuator_motion motion;
+		motion.name_ = cameras_[i].camera_name_;
+		motion.is_arm_ = false;
+		motion.device_index_ = i;
+		motion.configuration_ = configuration;
+		motion.state_ = calibration_interface_->getCameraStateMonitor(motion.name_);
+		motion.chain_ = cameras_[i].kinematic_chain_;
+		motions.push_back(motion);
+	}
+}
 
-		double norm = 0.f;
-		for (int i = 0; i<cur_state.size(); ++i)
+unsigned short CalibrationType::startMotion(const actuator_motion &motion)
+{
+	if ( motion.is_arm_ )
+	{
+		ROS_ERROR("CalibrationType::startMotion - Calibration type %s does not move arms.", getString().c_str());
+		return MOV_ERR_FATAL;
+	}
+
+	return startCameraMotion(cameras_[motion.device_index_], *motion.configuration_, motion.state_);
+}
+
+bool CalibrationType::moveActuators(std::vector<actuator_motion> &motions)
+{
+	// Each round dispatches the goals of all unfinished actuators at once and then waits for all of them, so the round takes as
+	// long as the slowest motion. Actuators of the same kinematic chain, as declared by the interface, or sharing joint states go in separate rounds.
+	// Failed motions are retried in the next round, up to NUM_MOVE_TRIES times per actuator.
+	std::vector<size_t> dispatched;
+	while ( true )
+	{
+		std::set<std::string> busy_chains;
+		std::set<JointStateMonitor*> busy_states;
+		dispatched.clear();
+
+		for ( size_t i=0; i<motions.size(); ++i )
 		{
-			double error = cam_configuration[i]-cur_state[i];
-			norm += error*error;  // sum over squared errors
+			actuator_motion &motion = motions[i];
+			if ( motion.finished_ || busy_chains.count(motion.chain_) > 0 || busy_states.count(motion.state_) > 0 )
+				continue;
+
+			busy_chains.insert(motion.chain_);
+			busy_states.insert(motion.state_);
+
+			motion.error_code_ = startMotion(motion);
+			if ( motion.error_code_ == MOV_ERR_FATAL )
+			{
+				ROS_FATAL("CalibrationType::moveActuators - Exiting calibration.");
+				throw std::exception();
+			}
+			dispatched.push_back(i);
 		}
-		norm = std::sqrt(norm);  // take root
 
-		if ( norm < 0.025 ) //Close enough to goal configuration
-		{
-			std::cout << camera_name << " configuration reached, deviation: " << norm << std::endl;
+		if ( dispatched.empty() )  // all actuators reached their goal or have been skipped
 			break;
-		}
-	}
 
-	if ( time_utilities::getTimeElapsedSec(start_time) >= 10.f )
-	{
-		ROS_WARN("CalibrationType::moveCamera - Could not reach following camera configuration in time:");
-		for (int i = 0; i<cam_configuration.size(); ++i)
-			std::cout << cam_configuration[i] << "\t";
-		std::cout << std::endl;
+		bool retry = false;
+		for ( size_t i=0; i<dispatched.size(); ++i )
+		{
+			actuator_motion &motion = motions[dispatched[i]];
+			if ( motion.error_code_ == MOV_NO_ERR )
+				motion.error_code_ = waitForMotion(motion.name_, motion.state_, *motion.configuration_);
 
-		return MOV_ERR_SOFT;
+			if ( motion.error_code_ == MOV_NO_ERR )  // successfully executed move
+			{
+				motion.finished_ = true;
+				continue;
+			}
+
+			++motion.tries_;
+			ROS_WARN("CalibrationType::moveActuators - Could not move %s, (%d/%d) tries.", motion.name_.c_str(), motion.tries_, NUM_MOVE_TRIES);
+			if ( motion.tries_ < NUM_MOVE_TRIES )
+				retry = true;
+			else
+			{
+				ROS_WARN("CalibrationType::moveActuators - Skipping configuration of %s.", motion.name_.c_str());
+				motion.finished_ = true;
+			}
+		}
+
+		if ( retry )
+		{
+			ROS_INFO("CalibrationType::moveActuators - Trying again in 2 sec.");
+			ros::Duration(2.f).sleep();
+		}
 	}
 
-	return error_code;
+	return true;
 }
 
 int CalibrationType::getConfigurationCount()
@@ -334,6 +446,14 @@ int CalibrationType::getConfigurationCount()
 	return max_configuration_count;
 }
 
+int CalibrationType::getScheduledIndex(int config_index) const
+{
+	if ( config_index >= 0 && config_index < configuration_order_.size() )
+		return configuration_order_[config_index];
+
+	return config_index;
+}
+
 void CalibrationType::getUncertainties(std::vector<std::string> &uncertainties_list)
 {
 	uncertainties_list = uncertainties_list_;
@@ -418,3 +538,137 @@ bool CalibrationType::passesMaxDeltaAngleCheck(const std::vector<double> &state,
 
 	return true;
 }
+
+void CalibrationType::readJointSpeeds(const std::string &name, const int dof_count, std::vector<double> &joint_speeds)
+{
+	node_handle_.getParam((name+"_joint_speeds"), joint_speeds);
+
+	if ( joint_speeds.size() != dof_count )
+	{
+		if ( !joint_speeds.empty() )
+			ROS_WARN("CalibrationType::readJointSpeeds - %s_joint_speeds vector has wrong size, DoF %d. Using 1 rad/s for each joint.", name.c_str(), dof_count);
+		joint_speeds.assign(dof_count, 1.0);
+	}
+
+	for ( int i=0; i<joint_speeds.size(); ++i )
+	{
+		if ( joint_speeds[i] <= 0.0 )
+			joint_speeds[i] = 1.0;
+	}
+}
+
+double CalibrationType::getJointTransitionTime(const std::vector<double> &from, const std::vector<double> &to, const int offset, const std::vector<double> &joint_speeds, const double max_delta_angle)
+{
+	double time = 0.0;
+	bool refused = false;
+
+	for ( int i=0; i<joint_speeds.size() && offset+i<from.size() && offset+i<to.size(); ++i )
+	{
+		const double delta = to[offset+i] - from[offset+i];
+		time = std::max(time, std::fabs(delta)/joint_speeds[i]);
+
+		if ( max_delta_angle > 0.0 )  // same check as passesMaxDeltaAngleCheck()
+		{
+			double delta_angle = delta;
+			while (delta_angle < -CV_PI)
+				delta_angle += 2*CV_PI;
+			while (delta_angle > CV_PI)
+				delta_angle -= 2*CV_PI;
+
+			refused |= ( fabs(delta_angle) > max_delta_angle );
+		}
+	}
+
+	return ( refused ? time + TRANSITION_PENALTY : time );
+}
+
+bool CalibrationType::isTransitionFeasible(int from_index, int to_index)
+{
+	std::vector<double> from, to;
+	if ( !getConfigurationParameters(from_index, from) || !getConfigurationParameters(to_index, to) )
+		return true;
+
+	return ( getTransitionTime(from, to) < TRANSITION_PENALTY );
+}
+
+void CalibrationType::scheduleConfigurations()
+{
+	configuration_order_.clear();
+
+	bool optimize_order = false;
+	node_handle_.param("optimize_configuration_order", optimize_order, false);
+	std::cout << "optimize_configuration_order: " << optimize_order << std::endl;
+
+	const int num_configs = max_configuration_count;
+	if ( !optimize_order || num_configs < 3 )
+		return;
+
+	std::vector< std::vector<double> > parameters(num_configs);
+	for ( int i=0; i<num_configs; ++i )
+	{
+		if ( !getConfigurationParameters(i, parameters[i]) )
+		{
+			ROS_WARN("CalibrationType::scheduleConfigurations - No parameters for configuration %d, keeping given order.", i);
+			return;
+		}
+	}
+
+	// nearest neighbour tour, starting at the first configuration
+	std::vector<int> order;
+	order.reserve(num_configs);
+	order.push_back(0);
+	std::vector<bool> scheduled(num_configs, false);
+	scheduled[0] = true;
+	for ( int k=1; k<num_configs; ++k )
+	{
+		int nearest = -1;
+		double nearest_time = std::numeric_limits<double>::max();
+		for ( int i=0; i<num_configs; ++i )
+		{
+			if ( scheduled[i] )
+				continue;
+
+			const double time = getTransitionTime(parameters[order.back()], parameters[i]);
+			if ( time < nearest_time )
+			{
+				nearest_time = time;
+				nearest = i;
+			}
+		}
+
+		order.push_back(nearest);
+		scheduled[nearest] = true;
+	}
+
+	// 2-opt: reverse a sub-path whenever this shortens the open tour, edge (i,i+1) and (j,j+1) are replaced by (i,j) and (i+1,j+1)
+	bool improved = true;
+	for ( int pass=0; improved && pass<MAX_SCHEDULING_PASSES; ++pass )
+	{
+		improved = false;
+		for ( int i=0; i+2<num_configs; ++i )
+		{
+			for ( int j=i+2; j<num_configs; ++j )
+			{
+				const bool last = ( j+1 == num_configs );  // reversing up to the end of the tour only replaces one edge
+				const double removed = getTransitionTime(parameters[order[i]], parameters[order[i+1]]) + ( last ? 0.0 : getTransitionTime(parameters[order[j]], parameters[order[j+1]]) );
+				const double added = getTransitionTime(parameters[order[i]], parameters[order[j]]) + ( last ? 0.0 : getTransitionTime(parameters[order[i+1]], parameters[order[j+1]]) );
+
+				if ( added < removed - 1e-9 )
+				{
+					std::reverse(order.begin()+i+1, order.begin()+j+1);
+					improved = true;
+				}
+			}
+		}
+	}
+
+	double given_time = 0.0, scheduled_time = 0.0;
+	for ( int i=0; i+1<num_configs; ++i )
+	{
+		given_time += getTransitionTime(parameters[i], parameters[i+1]);
+		scheduled_time += getTransitionTime(parameters[order[i]], parameters[order[i+1]]);
+	}
+	std::cout << "Estimated total transition time: " << given_time << " s in given order, " << scheduled_time << " s in scheduled order." << std::endl;
+
+	configuration_order_ = order;
+}
@@ -53,7 +53,8 @@
 #include <calibration_interface/ipa_interface.h>
 #include <opencv2/opencv.hpp>
 #include <std_msgs/Float64MultiArray.h>
-#include <robotino_calibration/time_utilities.h>
+#include <algorithm>
+#include <map>
 
 
 CameraArmType::CameraArmType()
@@ -87,6 +88,8 @@ void CameraArmType::initialize(ros::NodeHandle* nh, IPAInterface* calib_interfac
 			continue;
 		}
 
+		readJointSpeeds(arm_desc.arm_name_, arm_desc.dof_count_, arm_desc.joint_speeds_);
+		arm_desc.kinematic_chain_ = calibration_interface_->getKinematicChain(arm_desc.arm_name_, true);
 		arms_.push_back(arm_desc);
 		std::cout << arms_list[i] << ": DoF " << arms_list[i+1] << ", max delta angle: " << arms_list[i+2] << std::endl;
 	}
@@ -169,116 +172,94 @@ void CameraArmType::initialize(ros::NodeHandle* nh, IPAInterface* calib_interfac
 		return;
 	}
 
+	scheduleConfigurations();
+
 	initialized_ = true;
 }
 
 bool CameraArmType::moveRobot(int config_index)
 {
-	// Cameras move only when their assigned arms have finished moving
-	// How detect when an arm has finished moving?
-	// Camera moves -> arm moves in whole field of view of camera (corners, middle, etc), after that, camera moves and arm does same procedure again
-
-	bool result = CalibrationType::moveRobot(config_index);  // call parent
-
-	// Move arms
-	if ( result )
+	if ( !initialized_ )
 	{
-		for ( int i=0; i<arms_.size(); ++i )  // move one arm after the other
-		{
-			if ( config_index >= arms_[i].configurations_.size() )  // this arm has finished, continue with next
-				continue;
-
-			for ( short j=0; j<NUM_MOVE_TRIES; ++j )
-			{
-				unsigned short error_code = moveArm(arms_[i], arms_[i].configurations_[config_index]);
-
-				if ( error_code == MOV_NO_ERR ) // Exit loop, as successfully executed move
-				{
-					break;
-				}
-				else if ( error_code == MOV_ERR_SOFT ) // Retry last failed move
-				{
-					ROS_WARN("CameraArmType::moveRobot - Could not execute moveRobot, (%d/%d) tries.", i+1, NUM_MOVE_TRIES);
-					if ( i<NUM_MOVE_TRIES-1 )
-					{
-						ROS_INFO("CameraArmType::moveRobot - Trying again in 2 sec.");
-						ros::Duration(2.f).sleep();
-					}
-					else
-						ROS_WARN("CameraArmType::moveRobot - Skipping arm configuration %d of %s.", config_index, arms_[i].arm_name_.c_str());
-				}
-				else
-				{
-					ROS_FATAL("CameraArmType::moveRobot - Exiting calibration.");
-					throw std::exception();
-				}
-			}
-		}
+		ROS_WARN("CameraArmType::moveRobot - Not inizialized yet, no movement allowed!");
+		return false;
 	}
 
-	return result;
+	// Cameras and arms are driven independently, so all goals are dispatched at once and the robot waits for all of them
+	// instead of moving one camera and arm after the other
+	std::vector<actuator_motion> motions;
+	addCameraMotions(config_index, motions);
+	addArmMotions(config_index, motions);
+
+	return moveActuators(motions);
 }
 
 bool CameraArmType::moveCameras(int config_index)
 {
-	for ( int i=0; i<cameras_.size(); ++i )  // move one camera after the other
+	std::vector<actuator_motion> motions;
+	addCameraMotions(config_index, motions);
+
+	return moveActuators(motions);
+}
+
+const std::vector<double>* CameraArmType::getArmConfiguration(int config_index, int arm_index) const
+{
+	const std::vector< std::vector<double> > &configurations = arms_[arm_index].configurations_;
+	if ( config_index < 0 || configurations.empty() )
+		return 0;
+
+	// arms that have finished their configurations remain at their last one
+	return &configurations[std::min<int>(config_index, configurations.size()-1)];
+}
+
+void CameraArmType::addArmMotions(int config_index, std::vector<actuator_motion> &motions)
+{
+	for ( int i=0; i<arms_.size(); ++i )
 	{
-		if ( config_index >= cameras_[i].configurations_.size() )  // this camera has finished, continue with next
+		const std::vector<double>* configuration = getArmConfiguration(config_index, i);
+		if ( configuration == 0 )
 			continue;
 
-		for ( short j=0; j<NUM_MOVE_TRIES; ++j )
-		{
-			unsigned short error_code = moveCamera(cameras_[i], cameras_[i].configurations_[config_index]);
-
-			if ( error_code == MOV_NO_ERR ) // Exit loop, as successfully executed move
-			{
-				break;
-			}
-			else if ( error_code == MOV_ERR_SOFT ) // Retry last failed move
-			{
-				ROS_WARN("CalibrationType::moveCameras - Could not execute moveCamera, (%d/%d) tries.", i+1, NUM_MOVE_TRIES);
-				if ( i<NUM_MOVE_TRIES-1 )
-				{
-					ROS_INFO("CalibrationType::moveCameras - Trying again in 2 sec.");
-					ros::Duration(2.f).sleep();
-				}
-				else
-					ROS_WARN("CalibrationType::moveCameras - Skipping camera configuration %d of %s.", config_index, cameras_[i].camera_name_.c_str());
-			}
-			else
-			{
-				ROS_FATAL("CalibrationType::moveCameras - Exiting calibration.");
-				throw std::exception();
-			}
-		}
+		actuator_motion motion;
+		motion.name_ = arms_[i].arm_name_;
+		motion.is_arm_ = true;
+		motion.device_index_ = i;
+		motion.configuration_ = configuration;
+		motion.state_ = calibration_interface_->getArmStateMonitor(motion.name_);
+		motion.chain_ = arms_[i].kinematic_chain_;
+		motions.push_back(motion);
 	}
+}
 
-	return true;
+unsigned short CameraArmType::startMotion(const actuator_motion &motion)
+{
+	if ( !motion.is_arm_ )
+		return CalibrationType::startMotion(motion);
+
+	return startArmMotion(arms_[motion.device_index_], *motion.configuration_, motion.state_);
 }
 
-unsigned short CameraArmType::moveArm(const arm_description &arm, const std::vector<double>& arm_configuration)
+unsigned short CameraArmType::startArmMotion(const arm_description &arm, const std::vector<double>& arm_configuration, JointStateMonitor* arm_state)
 {
 	std_msgs::Float64MultiArray new_joint_config;
 	new_joint_config.data.resize(arm_configuration.size());
 
-	unsigned short error_code = MOV_NO_ERR;
 	const std::string &arm_name = arm.arm_name_;
 
 	for ( int i=0; i<new_joint_config.data.size(); ++i )
 		new_joint_config.data[i] = arm_configuration[i];
 
-	ros::spinOnce();
-	std::vector<double> cur_state = *calibration_interface_->getCurrentArmState(arm_name);
+	std::vector<double> cur_state;
 
-	if ( cur_state.empty() )
+	if ( arm_state == 0 || !arm_state->getState(cur_state, JOINT_STATE_TIMEOUT) || cur_state.empty() )
 	{
-		ROS_ERROR("CameraArmType::moveArm - Can't retrieve state of current arm %s.", arm_name.c_str());
+		ROS_ERROR("CameraArmType::startArmMotion - Can't retrieve state of current arm %s.", arm_name.c_str());
 		return MOV_ERR_FATAL;
 	}
 
 	if ( (int)cur_state.size() != (int)arm_configuration.size() )
 	{
-		ROS_ERROR("CameraArmType::moveArm - Size of target arm configuration and count of arm joints do not match! Please adjust the yaml file.");
+		ROS_ERROR("CameraArmType::startArmMotion - Size of target arm configuration and count of arm joints do not match! Please adjust the yaml file.");
 		return MOV_ERR_FATAL;
 	}
 
@@ -291,12 +272,12 @@ unsigned short CameraArmType::moveArm(const arm_description &arm, const std::vec
 		{
 			if ( bad_index == -1 )
 			{
-				ROS_ERROR("CameraArmType::moveArm - Size of target arm configuration and count of arm joints do not match! Please adjust the yaml file.");
+				ROS_ERROR("CameraArmType::startArmMotion - Size of target arm configuration and count of arm joints do not match! Please adjust the yaml file.");
 				return MOV_ERR_FATAL;
 			}
 			else
 			{
-				ROS_WARN("CameraArmType::moveArm - Angle number %d in target configuration of arm %s exceeds max allowed deviation %f!\n"
+				ROS_WARN("CameraArmType::startArmMotion - Angle number %d in target configuration of arm %s exceeds max allowed deviation %f!\n"
 						 "Please move the arm manually closer to the target position to avoid collision issues.", bad_index, arm_name.c_str(), max_delta_angle);
 				std::cout << "Current arm state: ";
 				for ( size_t j=0; j<cur_state.size(); ++j )
@@ -311,41 +292,57 @@ unsigned short CameraArmType::moveArm(const arm_description &arm, const std::vec
 	}
 
 	calibration_interface_->assignNewArmJoints(arm_name, new_joint_config);
+	return MOV_NO_ERR;
+}
 
-	// wait for arm to arrive at goal
-	const double start_time = time_utilities::getSystemTimeSec();
-	while ( time_utilities::getTimeElapsedSec(start_time) < 10.f ) //Max. 10 seconds to reach goal
-	{
-		ros::Rate(20).sleep(); // No need to iterate through this every tick
-		ros::spinOnce();
-		cur_state = *calibration_interface_->getCurrentArmState(arm_name);
+bool CameraArmType::getConfigurationParameters(int config_index, std::vector<double> &parameters)
+{
+	parameters.clear();
+	if ( config_index < 0 || config_index >= max_configuration_count )
+		return false;
 
-		double norm = 0.f;
-		for (int i = 0; i<cur_state.size(); ++i)
-		{
-			double error = arm_configuration[i]-cur_state[i];
-			norm += error*error;  // sum over squared errors
-		}
-		norm = std::sqrt(norm);  // take root
+	// the same configurations moveRobot() commands the cameras and arms to
+	for ( int i=0; i<cameras_.size(); ++i )
+	{
+		const std::vector<double>* configuration = getCameraConfiguration(config_index, i);
+		if ( configuration == 0 )
+			return false;
+		parameters.insert(parameters.end(), configuration->begin(), configuration->end());
+	}
 
-		if ( norm < 0.025 ) //Close enough to goal configuration
-		{
-			std::cout << "Arm configuration reached, deviation: " << norm << std::endl;
-			break;
-		}
+	for ( int i=0; i<arms_.size(); ++i )
+	{
+		const std::vector<double>* configuration = getArmConfiguration(config_index, i);
+		if ( configuration == 0 )
+			return false;
+		parameters.insert(parameters.end(), configuration->begin(), configuration->end());
 	}
 
-	if ( time_utilities::getTimeElapsedSec(start_time) >= 10.f )
+	return true;
+}
+
+double CameraArmType::getTransitionTime(const std::vector<double> &from, const std::vector<double> &to)
+{
+	// cameras and arms of different kinematic chains move at once, the ones of a chain one after another, see moveActuators()
+	std::map<std::string, double> chain_times;
+	int offset = 0;
+	for ( int i=0; i<cameras_.size(); ++i )
 	{
-		ROS_WARN("CameraArmType::moveArm - Could not reach following arm configuration in time:");
-		for (int i = 0; i<arm_configuration.size(); ++i)
-			std::cout << arm_configuration[i] << "\t";
-		std::cout << std::endl;
+		chain_times[cameras_[i].kinematic_chain_] += getJointTransitionTime(from, to, offset, cameras_[i].joint_speeds_, cameras_[i].max_delta_angle_);
+		offset += cameras_[i].dof_count_;
+	}
 
-		return MOV_ERR_SOFT;
+	for ( int i=0; i<arms_.size(); ++i )
+	{
+		chain_times[arms_[i].kinematic_chain_] += getJointTransitionTime(from, to, offset, arms_[i].joint_speeds_, arms_[i].max_delta_angle_);
+		offset += arms_[i].dof_count_;
 	}
 
-	return error_code;
+	double time = 0.0;
+	for ( std::map<std::string, double>::const_iterator it=chain_times.begin(); it!=chain_times.end(); ++it )
+		time = std::max(time, it->second);
+
+	return time;
 }
 
 std::string CameraArmType::getString()
@@ -54,11 +54,13 @@
 #include <robotino_calibration/transformation_utilities.h>
 #include <geometry_msgs/Twist.h>
 #include <robotino_calibration/time_utilities.h>
+#include <algorithm>
+#include <map>
 
 
 CameraLaserscannerType::CameraLaserscannerType() :
 		last_ref_history_update_(0.0), start_error_x_(0.0), start_error_y_(0.0), start_error_phi_(0.0), ref_history_index_(0), max_ref_frame_distance_(1.0),
-		mapped_base_index_(0), current_camera_counter_(0), mapped_camera_index_(0), cameras_done_(false)
+		base_linear_speed_(0.2), base_angular_speed_(0.5)
 {
 
 }
@@ -83,6 +85,16 @@ void CameraLaserscannerType::initialize(ros::NodeHandle* nh, IPAInterface* calib
 	node_handle_.param("max_ref_frame_distance", max_ref_frame_distance_, 1.0);
 	std::cout << "max_ref_frame_distance: " << max_ref_frame_distance_ << std::endl;
 
+	// base_speeds format: [linear speed in m/s, angular speed in rad/s]
+	std::vector<double> base_speeds;
+	node_handle_.getParam("base_speeds", base_speeds);
+	if ( base_speeds.size() == 2 && base_speeds[0] > 0.0 && base_speeds[1] > 0.0 )
+	{
+		base_linear_speed_ = base_speeds[0];
+		base_angular_speed_ = base_speeds[1];
+	}
+	std::cout << "base_speeds: " << base_linear_speed_ << ", " << base_angular_speed_ << std::endl;
+
 	const int base_dof = NUM_POSE_PARAMS; // coming from pose_definition.h
 
 	// read out user-defined robot configurations
@@ -181,6 +193,8 @@ void CameraLaserscannerType::initialize(ros::NodeHandle* nh, IPAInterface* calib
 	max_configuration_count *= base_configurations_.size();  // each base config contains all camera configs
 	std::cout << max_configuration_count << " configurations in total used for calibration." << std::endl;
 
+	scheduleConfigurations();
+
 	// Check whether relative_localization has initialized the reference frame yet.
 	// Do not let the robot start driving when the reference frame has not been set up properly! Bad things could happen!
 	const double start_time = time_utilities::getSystemTimeSec();
@@ -226,14 +240,12 @@ bool CameraLaserscannerType::moveRobot(int config_index)
 	bool result = CalibrationType::moveRobot(config_index);  // call parent to move current camera
 
 	// Move base
-	if ( result )
+	int base_index = 0, camera_index = 0, camera_config_index = 0;
+	if ( result && mapConfigIndex(config_index, base_index, camera_index, camera_config_index) )
 	{
-		if ( cameras_done_ )  // go to new location only when all cameras are done with previous location
-			++mapped_base_index_;
-
 		for ( short i=0; i<NUM_MOVE_TRIES; ++i )
 		{
-			unsigned short error_code = moveBase(base_configurations_[mapped_base_index_]);
+			unsigned short error_code = moveBase(base_configurations_[base_index]);
 
 			if ( error_code == MOV_NO_ERR ) // Exit loop, as successfully executed move
 			{
@@ -249,7 +261,7 @@ bool CameraLaserscannerType::moveRobot(int config_index)
 					ros::Duration(2.f).sleep();
 				}
 				else
-					ROS_WARN("CameraLaserscannerType::moveRobot - Skipping base configuration %d.", mapped_base_index_);
+					ROS_WARN("CameraLaserscannerType::moveRobot - Skipping base configuration %d.", base_index);
 			}
 			else
 			{
@@ -264,47 +276,100 @@ bool CameraLaserscannerType::moveRobot(int config_index)
 
 bool CameraLaserscannerType::moveCameras(int config_index)
 {
-	if ( cameras_done_ )  // reset flag after it was set the last call
-		cameras_done_ = false;
+	int base_index = 0, camera_index = 0, camera_config_index = 0;
+	if ( !mapConfigIndex(config_index, base_index, camera_index, camera_config_index) )
+	{
+		ROS_ERROR("CameraLaserscannerType::moveCameras - Invalid configuration index %d.", config_index);
+		return false;
+	}
 
-	int current_count = cameras_[current_camera_counter_].configurations_.size();  // count of current configurations of current camera
+	// all cameras are commanded, not only the one this configuration is about, as configurations may be visited in any order
+	std::vector<actuator_motion> motions;
+	addCameraMotions(config_index, motions);
 
-	if ( config_index > 0 && mapped_camera_index_ % current_count == 0 )  // cameras move one after an other
-	{
-		current_camera_counter_ = ( (current_camera_counter_+1 >= cameras_.size()) ? 0 : current_camera_counter_+1 );  // when previous camera has iterated through all its configs, do same with next camera
-		mapped_camera_index_ = 0;
+	return moveActuators(motions);
+}
 
-		if ( current_camera_counter_ == 0 )  // set for one call, reset on next call
-			cameras_done_ = true;
-	}
+const std::vector<double>* CameraLaserscannerType::getCameraConfiguration(int config_index, int camera_index) const
+{
+	int base_index = 0, active_camera_index = 0, camera_config_index = 0;
+	if ( !mapConfigIndex(config_index, base_index, active_camera_index, camera_config_index) || cameras_[camera_index].configurations_.empty() )
+		return 0;
+
+	// cameras this configuration is not about are parked at the end of their configurations
+	if ( camera_index == active_camera_index )
+		return &cameras_[camera_index].configurations_[camera_config_index];
+
+	return &cameras_[camera_index].configurations_.back();
+}
+
+bool CameraLaserscannerType::mapConfigIndex(int config_index, int &base_index, int &camera_index, int &camera_config_index) const
+{
+	int camera_configs = 0;  // count of all camera configurations at one base location
+	for ( int i=0; i<cameras_.size(); ++i )
+		camera_configs += cameras_[i].configurations_.size();
 
-	for ( short i=0; i<NUM_MOVE_TRIES; ++i )
+	if ( config_index < 0 || camera_configs <= 0 || config_index >= camera_configs*(int)base_configurations_.size() )
+		return false;
+
+	base_index = config_index / camera_configs;
+	camera_config_index = config_index % camera_configs;
+	for ( camera_index=0; camera_config_index >= (int)cameras_[camera_index].configurations_.size(); ++camera_index )
+		camera_config_index -= cameras_[camera_index].configurations_.size();
+
+	return true;
+}
+
+double CameraLaserscannerType::getTransitionTime(const std::vector<double> &from, const std::vector<double> &to)
+{
+	if ( from.size() < 3 || to.size() < 3 )
+		return 0.0;
+
+	// cameras move first, those of different kinematic chains at once, then the base drives and turns, see moveRobot()
+	double delta_phi = to[2] - from[2];
+	while (delta_phi < -CV_PI)
+		delta_phi += 2*CV_PI;
+	while (delta_phi > CV_PI)
+		delta_phi -= 2*CV_PI;
+
+	const double dx = to[0] - from[0];
+	const double dy = to[1] - from[1];
+	std::map<std::string, double> chain_times;
+	int offset = 3;
+	for ( int i=0; i<cameras_.size(); ++i )
 	{
-		unsigned short error_code = moveCamera(cameras_[current_camera_counter_], cameras_[current_camera_counter_].configurations_[mapped_camera_index_]);
+		chain_times[cameras_[i].kinematic_chain_] += getJointTransitionTime(from, to, offset, cameras_[i].joint_speeds_, cameras_[i].max_delta_angle_);
+		offset += cameras_[i].dof_count_;
+	}
 
-		if ( error_code == MOV_NO_ERR ) // Exit loop, as successfully executed move
-		{
-			break;
-		}
-		else if ( error_code == MOV_ERR_SOFT ) // Retry last failed move
-		{
-			ROS_WARN("CalibrationType::moveCameras - Could not execute moveCamera, (%d/%d) tries.", i+1, NUM_MOVE_TRIES);
-			if ( i<NUM_MOVE_TRIES-1 )
-			{
-				ROS_INFO("CalibrationType::moveCameras - Trying again in 2 sec.");
-				ros::Duration(2.f).sleep();
-			}
-			else
-				ROS_WARN("CalibrationType::moveCameras - Skipping camera configuration %d of %s.", mapped_camera_index_, cameras_[current_camera_counter_].camera_name_.c_str());
-		}
-		else
-		{
-			ROS_FATAL("CalibrationType::moveCameras - Exiting calibration.");
-			throw std::exception();
-		}
+	double camera_time = 0.0;
+	for ( std::map<std::string, double>::const_iterator it=chain_times.begin(); it!=chain_times.end(); ++it )
+		camera_time = std::max(camera_time, it->second);
+
+	return camera_time + std::sqrt(dx*dx + dy*dy)/base_linear_speed_ + std::fabs(delta_phi)/base_angular_speed_;
+}
+
+bool CameraLaserscannerType::getConfigurationParameters(int config_index, std::vector<double> &parameters)
+{
+	parameters.clear();
+
+	int base_index = 0, camera_index = 0, camera_config_index = 0;
+	if ( !mapConfigIndex(config_index, base_index, camera_index, camera_config_index) )
+		return false;
+
+	parameters.push_back(base_configurations_[base_index].pose_x_);
+	parameters.push_back(base_configurations_[base_index].pose_y_);
+	parameters.push_back(base_configurations_[base_index].pose_phi_);
+
+	// the same configurations moveCameras() commands the cameras to
+	for ( int i=0; i<cameras_.size(); ++i )
+	{
+		const std::vector<double>* configuration = getCameraConfiguration(config_index, i);
+		if ( configuration == 0 )
+			return false;
+		parameters.insert(parameters.end(), configuration->begin(), configuration->end());
 	}
 
-	++mapped_camera_index_;
 	return true;
 }
 
@@ -0,0 +1,494 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: June 2018
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#include <calibration_interface/checkerboard_detector.h>
+#include <calibration_interface/checkerboard_marker.h>
+#include <robotino_calibration/transformation_utilities.h>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#include <std_msgs/Float64.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <iostream>
+#include <limits>
+#include <cmath>
+
+
+static const double MAX_IMAGE_AGE = 10.0;  // [s] images and detections of a camera that has not sent a newer image are outdated
+
+
+// shares the message data for mono8 images, other encodings are converted to grayscale exactly once
+bool convertImageMessageToGray(const sensor_msgs::Image::ConstPtr& image_msg, cv_bridge::CvImageConstPtr& gray_ptr)
+{
+	try
+	{
+		gray_ptr = cv_bridge::toCvShare(image_msg, sensor_msgs::image_encodings::MONO8);
+	}
+	catch (cv_bridge::Exception& e)
+	{
+		ROS_ERROR("CheckerboardDetector::convertImageMessageToGray - cv_bridge exception: %s", e.what());
+		return false;
+	}
+
+	return true;
+}
+
+
+template<typename T>
+void CheckerboardDetector::loadParameter(ros::NodeHandle &nh, const std::string &name, T &value, const T &default_value)
+{
+	if ( !camera_name_.empty() && node_handle_.hasParam(name) )
+		node_handle_.getParam(name, value);
+	else
+		nh.param<T>(name, value, default_value);
+}
+
+void CheckerboardDetector::loadFilterParameter(ros::NodeHandle &nh, const std::string &name, const double default_translation,
+											   const double default_rotation, double* value)
+{
+	std::vector<double> temp;
+	loadParameter< std::vector<double> >(nh, name, temp, std::vector<double>());
+	value[0] = ( temp.size() == 2 ? temp[0] : default_translation );
+	value[1] = ( temp.size() == 2 ? temp[1] : default_rotation );
+	std::cout << name << ": [" << value[0] << ", " << value[1] << "]" << std::endl;
+}
+
+CheckerboardDetector::CheckerboardDetector(ros::NodeHandle &nh, image_transport::ImageTransport &it, const std::string &camera_name,
+										   const boost::function<void (CheckerboardDetector*)> &new_frame_callback) :
+		node_handle_(camera_name.empty() ? nh : ros::NodeHandle(nh, camera_name)), camera_name_(camera_name), checkerboard_cell_size_(0.05),
+		num_distortion_params_(0), use_tracking_(true), tracking_roi_padding_(0.25), tracking_pyramid_levels_(0),
+		ransac_fallback_(true), max_reprojection_rms_(1.0),
+		new_frame_callback_(new_frame_callback), initialized_(false), tracking_valid_(false),
+		detection_valid_(false), converged_std_translation_(0.002), converged_std_rotation_(0.004)
+{
+	std::cout << "\n========== Checkerboard Detector Parameters " << camera_name_ << " ==========\n";
+	loadParameter<std::string>(nh, "camera_frame", camera_frame_, "");
+	std::cout << "camera_frame: " << camera_frame_ << std::endl;
+
+	loadParameter<std::string>(nh, "checkerboard_frame", checkerboard_frame_, "");
+	std::cout << "checkerboard_frame: " << checkerboard_frame_ << std::endl;
+
+	std::string camera_image_topic;
+	loadParameter<std::string>(nh, "camera_image_raw_topic", camera_image_topic, "");
+	std::cout << "camera_image_raw_topic: " << camera_image_topic << std::endl;
+
+	std::string camera_info;
+	loadParameter<std::string>(nh, "camera_info_topic", camera_info, "");
+	std::cout << "camera_info_topic: " << camera_info << std::endl;
+
+	loadParameter<int>(nh, "number_distortion_parameters", num_distortion_params_, 0);
+	num_distortion_params_ = std::max(num_distortion_params_, 0);  // min: 0
+	std::cout << "number_distortion_parameters: " << num_distortion_params_ << std::endl;
+
+	loadParameter<double>(nh, "checkerboard_cell_size", checkerboard_cell_size_, 0.05);
+	std::cout << "checkerboard_cell_size: " << checkerboard_cell_size_ << std::endl;
+
+	std::vector<double> temp;
+	loadParameter< std::vector<double> >(nh, "checkerboard_pattern_size", temp, std::vector<double>());
+	if (temp.size() == 2)
+		checkerboard_pattern_size_ = cv::Size(temp[0], temp[1]);
+
+	// pose filter, each parameter is given as [translation in m, rotation in rad]
+	double measurement_std[2], process_std[2], converged_std[2];
+	loadFilterParameter(nh, "filter_measurement_std", 0.005, 0.01, measurement_std);
+	loadFilterParameter(nh, "filter_process_std", 0.001, 0.002, process_std);
+	loadFilterParameter(nh, "filter_converged_std", 0.002, 0.004, converged_std);
+	double innovation_gate;
+	loadParameter<double>(nh, "filter_innovation_gate", innovation_gate, 11.34);
+	std::cout << "filter_innovation_gate: " << innovation_gate << std::endl;
+	pose_filter_ = PoseFilter(measurement_std[0], measurement_std[1], process_std[0], process_std[1], innovation_gate);
+	converged_std_translation_ = converged_std[0];
+	converged_std_rotation_ = converged_std[1];
+
+	loadParameter<bool>(nh, "use_tracking", use_tracking_, true);
+	std::cout << "use_tracking: " << use_tracking_ << std::endl;
+
+	loadParameter<double>(nh, "tracking_roi_padding", tracking_roi_padding_, 0.25);
+	tracking_roi_padding_ = fmax(tracking_roi_padding_, 0.0);  // min: 0
+	std::cout << "tracking_roi_padding: " << tracking_roi_padding_ << std::endl;
+
+	loadParameter<int>(nh, "tracking_pyramid_levels", tracking_pyramid_levels_, 0);
+	tracking_pyramid_levels_ = std::min(std::max(tracking_pyramid_levels_, 0), 3);  // between [0, 3]
+	std::cout << "tracking_pyramid_levels: " << tracking_pyramid_levels_ << std::endl;
+
+	loadParameter<bool>(nh, "ransac_fallback", ransac_fallback_, true);
+	std::cout << "ransac_fallback: " << ransac_fallback_ << std::endl;
+
+	loadParameter<double>(nh, "max_reprojection_rms", max_reprojection_rms_, 1.0);
+	std::cout << "max_reprojection_rms: " << max_reprojection_rms_ << std::endl;
+
+	CheckerboardMarker::getPatternPoints3D(pattern_points_3d_, checkerboard_pattern_size_, checkerboard_cell_size_);
+	reprojection_rms_pub_ = node_handle_.advertise<std_msgs::Float64>("reprojection_rms", 1, false);
+	pose_pub_ = node_handle_.advertise<geometry_msgs::PoseWithCovarianceStamped>("checkerboard_pose", 1, false);
+
+	// Set up callbacks
+	info_sub_ = nh.subscribe<sensor_msgs::CameraInfo>(camera_info, 0, &CheckerboardDetector::infoCallback, this);
+	image_sub_ = it.subscribe(camera_image_topic, 1, &CheckerboardDetector::imageCallback, this);
+}
+
+CheckerboardDetector::~CheckerboardDetector()
+{
+	info_sub_.shutdown();
+	image_sub_.shutdown();
+}
+
+void CheckerboardDetector::infoCallback(const sensor_msgs::CameraInfoConstPtr& camera_info_msg)
+{
+	boost::mutex::scoped_lock lock(camera_data_mutex_);
+	if ( !initialized_ )
+	{
+		cam_matrix_ = (cv::Mat_<double>(3,3) <<
+					camera_info_msg->K[0], camera_info_msg->K[1], camera_info_msg->K[2],
+					camera_info_msg->K[3], camera_info_msg->K[4], camera_info_msg->K[5],
+					camera_info_msg->K[6], camera_info_msg->K[7], camera_info_msg->K[8]);
+
+		if ( num_distortion_params_ > 0 )
+		{
+			distortion_ = cv::Mat::zeros(num_distortion_params_, 1, CV_64F);
+			for ( int i=0; i<num_distortion_params_; ++i )
+				distortion_.at<double>(i) = camera_info_msg->D[i];
+		}
+		else // fallback
+		{
+			ROS_WARN("CheckerboardDetector::infoCallback - Zero distortion parameters, using plumb_bob model with all entries set to zero.");
+			distortion_ = cv::Mat::zeros(5, 1, CV_64F);
+		}
+
+		if ( !cam_matrix_.empty() && !distortion_.empty() )
+		{
+			initialized_ = true;
+			std::cout << "CheckerboardDetector::infoCallback - Intrinsic parameters of " << (camera_name_.empty() ? camera_frame_ : camera_name_) << " loaded" << std::endl;
+		}
+	}
+}
+
+void CheckerboardDetector::imageCallback(const sensor_msgs::ImageConstPtr& image_msg)
+{
+	// only keep a reference to the newest message, conversion and detection happen in detect()
+	{
+		boost::mutex::scoped_lock lock(camera_data_mutex_);
+		latest_image_msg_ = image_msg;
+		latest_image_time_ = image_msg->header.stamp;
+
+		if ( !latest_image_time_.isValid() )
+			latest_image_time_ = ros::Time::now();
+	}
+
+	if ( new_frame_callback_ )
+		new_frame_callback_(this);
+}
+
+bool CheckerboardDetector::isInitialized()
+{
+	boost::mutex::scoped_lock lock(camera_data_mutex_);
+	return initialized_;
+}
+
+bool CheckerboardDetector::detect()
+{
+	sensor_msgs::ImageConstPtr image_msg;
+	ros::Time image_time;
+	cv::Mat cam_matrix, distortion;  // headers only, the intrinsics are never written again once initialized
+	{
+		boost::mutex::scoped_lock lock(camera_data_mutex_);
+		if ( !initialized_ )
+			return false;
+
+		image_msg = latest_image_msg_;
+		image_time = latest_image_time_;
+		cam_matrix = cam_matrix_;
+		distortion = distortion_;
+	}
+
+	if ( !image_msg || image_msg == processed_image_msg_ || (ros::Time::now() - image_time).toSec() >= MAX_IMAGE_AGE )  // each frame is searched only once
+		return false;
+
+	processed_image_msg_ = image_msg;
+	cv_bridge::CvImageConstPtr gray_ptr;
+	if ( !convertImageMessageToGray(image_msg, gray_ptr) )
+	{
+		setDetectionValid(false, image_time);
+		return false;
+	}
+
+	const cv::Mat &gray = gray_ptr->image;
+
+	// check if all corner points are available
+	const bool last_pose_valid = tracking_valid_;
+	std::vector<cv::Point2f> checkerboard_points_2d;
+	tracking_valid_ = findCorners(gray, cam_matrix, distortion, checkerboard_points_2d);
+	if ( !tracking_valid_ )
+	{
+		setDetectionValid(false, image_time);
+		return true;
+	}
+
+	// get rotation and translation vectors, starting from the pose of the last frame if there is one
+	cv::Mat rvec, tvec;
+	double rms = 0.;
+	if ( last_pose_valid )
+	{
+		rvec = last_rvec_.clone();
+		tvec = last_tvec_.clone();
+	}
+
+	if ( !estimatePose(checkerboard_points_2d, cam_matrix, distortion, last_pose_valid, rvec, tvec, rms) )
+	{
+		tracking_valid_ = false;
+		setDetectionValid(false, image_time);
+		return true;
+	}
+
+	last_rvec_ = rvec;
+	last_tvec_ = tvec;
+
+	std_msgs::Float64 rms_msg;
+	rms_msg.data = rms;
+	reprojection_rms_pub_.publish(rms_msg);
+
+	cv::Mat R;
+	cv::Rodrigues(rvec, R);
+	tf::Vector3 translation(tvec.at<double>(0), tvec.at<double>(1), tvec.at<double>(2));
+	cv::Vec3d ypr = transform_utilities::YPRFromRotationMatrix(R);
+	tf::Quaternion orientation;
+	orientation.setRPY(ypr.val[2], ypr.val[1], ypr.val[0]);
+
+	// update filtered transform
+	boost::mutex::scoped_lock lock(transform_mutex_);
+	pose_filter_.update(translation, orientation, image_time.toSec());
+	detection_valid_ = true;
+	detection_time_ = image_time;
+
+	return true;
+}
+
+void CheckerboardDetector::setDetectionValid(const bool valid, const ros::Time &image_time)
+{
+	boost::mutex::scoped_lock lock(transform_mutex_);
+	detection_valid_ = valid;
+	detection_time_ = image_time;
+}
+
+bool CheckerboardDetector::findCorners(const cv::Mat &gray, const cv::Mat &cam_matrix, const cv::Mat &distortion, std::vector<cv::Point2f> &corners)
+{
+	const cv::Rect full_image(0, 0, gray.cols, gray.rows);
+	bool pattern_found = false;
+
+	// the checkerboard barely moves between frames, so search around its last pose first
+	cv::Rect roi;
+	if ( use_tracking_ && tracking_valid_ && getTrackingROI(full_image.size(), cam_matrix, distortion, roi) )
+		pattern_found = searchCorners(gray, roi, tracking_pyramid_levels_, corners);
+
+	if ( !pattern_found )  // lost track, fall back to the whole image at full resolution
+		pattern_found = searchCorners(gray, full_image, 0, corners);
+
+	if ( !pattern_found )
+		return false;
+
+	// improves result, taken from https://docs.opencv.org/2.4/doc/tutorials/calib3d/camera_calibration/camera_calibration.html
+	// always refined at full resolution, the window also covers the error of corners found on a downscaled level
+	cv::cornerSubPix( gray, corners, cv::Size(11,11),
+						cv::Size(-1,-1), cv::TermCriteria( cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1 ));
+
+	return true;
+}
+
+bool CheckerboardDetector::estimatePose(const std::vector<cv::Point2f> &corners, const cv::Mat &cam_matrix, const cv::Mat &distortion, const bool use_guess,
+										cv::Mat &rvec, cv::Mat &tvec, double &rms)
+{
+	// correspondences of a checkerboard are unambiguous, so a plain iterative solution is enough in general
+	bool result = cv::solvePnP(pattern_points_3d_, corners, cam_matrix, distortion, rvec, tvec, use_guess);
+	if ( result && !rvec.empty() && rvec.size() == tvec.size() )  // check for valid size, we should have a size of one for both vectors
+		rms = computeReprojectionRMS(corners, cam_matrix, distortion, rvec, tvec);
+	else
+	{
+		result = false;
+		rms = std::numeric_limits<double>::max();
+	}
+
+	if ( ransac_fallback_ && rms > max_reprojection_rms_ )
+	{
+		cv::Mat ransac_rvec, ransac_tvec;
+		cv::solvePnPRansac(pattern_points_3d_, corners, cam_matrix, distortion, ransac_rvec, ransac_tvec);
+
+		if ( !ransac_rvec.empty() && ransac_rvec.size() == ransac_tvec.size() )
+		{
+			const double ransac_rms = computeReprojectionRMS(corners, cam_matrix, distortion, ransac_rvec, ransac_tvec);
+			if ( ransac_rms < rms )
+			{
+				rvec = ransac_rvec;
+				tvec = ransac_tvec;
+				rms = ransac_rms;
+				result = true;
+			}
+		}
+	}
+
+	return result;
+}
+
+double CheckerboardDetector::computeReprojectionRMS(const std::vector<cv::Point2f> &corners, const cv::Mat &cam_matrix, const cv::Mat &distortion,
+													const cv::Mat &rvec, const cv::Mat &tvec)
+{
+	if ( corners.empty() )
+		return 0.;
+
+	std::vector<cv::Point2f> projected_corners;
+	cv::projectPoints(pattern_points_3d_, rvec, tvec, cam_matrix, distortion, projected_corners);
+
+	double sum = 0.;
+	for ( size_t i=0; i<corners.size() && i<projected_corners.size(); ++i )
+	{
+		const double dx = corners[i].x - projected_corners[i].x;
+		const double dy = corners[i].y - projected_corners[i].y;
+		sum += dx*dx + dy*dy;
+	}
+
+	return std::sqrt(sum/corners.size());
+}
+
+bool CheckerboardDetector::getTrackingROI(const cv::Size &image_size, const cv::Mat &cam_matrix, const cv::Mat &distortion, cv::Rect &roi)
+{
+	if ( last_rvec_.empty() || last_tvec_.empty() )
+		return false;
+
+	// the outer squares reach one cell beyond the outer corner points
+	const double c = checkerboard_cell_size_;
+	const double width = checkerboard_pattern_size_.width*c;
+	const double height = checkerboard_pattern_size_.height*c;
+	std::vector<cv::Point3f> outer_corners;
+	outer_corners.push_back(cv::Point3f(-c, -c, 0.f));
+	outer_corners.push_back(cv::Point3f(width, -c, 0.f));
+	outer_corners.push_back(cv::Point3f(-c, height, 0.f));
+	outer_corners.push_back(cv::Point3f(width, height, 0.f));
+
+	std::vector<cv::Point2f> projected_corners;
+	cv::projectPoints(outer_corners, last_rvec_, last_tvec_, cam_matrix, distortion, projected_corners);
+
+	const cv::Rect bounding_box = cv::boundingRect(projected_corners);
+	const int padding_x = (int)(tracking_roi_padding_*bounding_box.width);
+	const int padding_y = (int)(tracking_roi_padding_*bounding_box.height);
+	roi = cv::Rect(bounding_box.x-padding_x, bounding_box.y-padding_y, bounding_box.width+2*padding_x, bounding_box.height+2*padding_y)
+			& cv::Rect(0, 0, image_size.width, image_size.height);
+
+	// searching a region of interest only pays off if it is noticeably smaller than the image
+	return ( roi.width > 0 && roi.height > 0 && roi.area() < 0.75*image_size.area() );
+}
+
+bool CheckerboardDetector::searchCorners(const cv::Mat &gray, const cv::Rect &roi, const int pyramid_levels, std::vector<cv::Point2f> &corners)
+{
+	cv::Mat search_image = gray(roi);  // no copy, only a header pointing into gray
+	for ( int i=0; i<pyramid_levels; ++i )
+	{
+		cv::Mat downscaled;
+		cv::pyrDown(search_image, downscaled);
+		search_image = downscaled;
+	}
+
+	if ( !cv::findChessboardCorners(search_image, checkerboard_pattern_size_, corners,
+									cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE + cv::CALIB_CB_FAST_CHECK) )
+		return false;
+
+	// back to full image coordinates
+	const float scale = (float)(1 << pyramid_levels);
+	for ( size_t i=0; i<corners.size(); ++i )
+	{
+		corners[i].x = corners[i].x*scale + roi.x;
+		corners[i].y = corners[i].y*scale + roi.y;
+	}
+
+	return true;
+}
+
+void CheckerboardDetector::publishTransform(tf::TransformBroadcaster &transform_broadcaster)
+{
+	geometry_msgs::PoseWithCovarianceStamped pose_msg;
+	tf::Transform transform;
+	bool converged = false;
+	bool detection_valid = false;
+	ros::Time detection_time;
+	const ros::Time now = ros::Time::now();
+	{
+		// the camera driver may have died, its last detection must not stay on tf
+		boost::mutex::scoped_lock lock(camera_data_mutex_);
+		if ( !latest_image_msg_ || (now - latest_image_time_).toSec() >= MAX_IMAGE_AGE )
+			return;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(transform_mutex_);
+		if ( !pose_filter_.isInitialized() )
+			return;
+
+		transform = pose_filter_.getTransform();
+		pose_filter_.getCovariance(&pose_msg.pose.covariance[0], now.toSec());  // the uncertainty keeps growing while the checkerboard is not detected
+		converged = pose_filter_.isConverged(converged_std_translation_, converged_std_rotation_, now.toSec());
+		detection_valid = detection_valid_;
+		detection_time = detection_time_;
+	}
+
+	pose_msg.header.stamp = detection_time;
+	pose_msg.header.frame_id = camera_frame_;
+	tf::poseTFToMsg(transform, pose_msg.pose.pose);
+	pose_pub_.publish(pose_msg);
+
+	// the calibration waits for a steady tf, so the frame is withheld until the filter has converged. it is only sent while the
+	// checkerboard is visible and carries the stamp of the image it has been found in, so consumers can reject outdated poses
+	if ( converged && detection_valid )
+	{
+		tf::StampedTransform tf_msg(transform, detection_time, camera_frame_, checkerboard_frame_);
+		transform_broadcaster.sendTransform(tf_msg);
+	}
+}
+
+const std::string& CheckerboardDetector::getCameraName() const
+{
+	return camera_name_;
+}
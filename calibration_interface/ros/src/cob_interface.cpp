@@ -66,7 +66,7 @@ CobInterface::CobInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 
 	node_handle_.param<std::string>("camera_joint_state_topic", camera_joint_state_topic_, "");
 	std::cout << "camera_joint_state_topic: " << camera_joint_state_topic_ << std::endl;
-	camera_state_ = node_handle_.subscribe<sensor_msgs::JointState>(camera_joint_state_topic_, 0, &CobInterface::cameraStateCallback, this);
+	camera_state_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(camera_joint_state_topic_, 0, &CobInterface::cameraStateCallback, this);
 
 	if ( arm_calibration_ )
 	{
@@ -76,7 +76,7 @@ CobInterface::CobInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 
 		node_handle_.param<std::string>("arm_left_state_topic", arm_left_state_topic_, "");
 		std::cout << "arm_left_state_topic: " << arm_left_state_topic_ << std::endl;
-		arm_left_state_ = node_handle_.subscribe<sensor_msgs::JointState>(arm_left_state_topic_, 0, &CobInterface::armLeftStateCallback, this);
+		arm_left_state_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(arm_left_state_topic_, 0, &CobInterface::armLeftStateCallback, this);
 
 		node_handle_.param<std::string>("arm_right_command", arm_right_command_, "");
 		std::cout << "arm_right_command: " << arm_right_command_ << std::endl;
@@ -84,7 +84,7 @@ CobInterface::CobInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 
 		node_handle_.param<std::string>("arm_right_state_topic", arm_right_state_topic_, "");
 		std::cout << "arm_right_state_topic: " << arm_right_state_topic_ << std::endl;
-		arm_right_state_ = node_handle_.subscribe<sensor_msgs::JointState>(arm_right_state_topic_, 0, &CobInterface::armRightStateCallback, this);
+		arm_right_state_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(arm_right_state_topic_, 0, &CobInterface::armRightStateCallback, this);
 	}
 	else
 	{
@@ -131,7 +131,7 @@ void CobInterface::assignNewCameraAngles(const std::string &camera_name, std_msg
 
 }
 
-std::vector<double>* CobInterface::getCurrentCameraState(const std::string &camera_name)
+JointStateMonitor* CobInterface::getCameraStateMonitor(const std::string &camera_name)
 {
 	return 0;
 }
@@ -141,7 +141,7 @@ void CobInterface::assignNewArmJoints(const std::string &arm_name, std_msgs::Flo
 
 }
 
-std::vector<double>* CobInterface::getCurrentArmState(const std::string &arm_name)
+JointStateMonitor* CobInterface::getArmStateMonitor(const std::string &arm_name)
 {
 	return 0;
 }
@@ -56,17 +56,112 @@
 #include <calibration_interface/robotino_interface.h>
 #include <calibration_interface/raw_interface.h>
 #include <calibration_interface/cob_interface.h>
+#include <boost/thread/thread_time.hpp>
 #include <exception>
 #include <iostream>
+#include <cmath>
 
 
-IPAInterface::IPAInterface()
+JointStateMonitor::JointStateMonitor() :
+				valid_(false)
+{
+}
+
+void JointStateMonitor::update(const std::vector<double> &positions)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		positions_.assign(positions.begin(), positions.end());  // reuses the storage as long as the joint count stays the same
+		valid_ = true;
+	}
+	condition_.notify_all();
+}
+
+void JointStateMonitor::update(const sensor_msgs::JointState &msg, const std::vector<std::string> &joint_names)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		positions_.resize(joint_names.size(), 0.);
+		for ( size_t i=0; i<msg.name.size() && i<msg.position.size(); ++i )
+		{
+			for ( size_t j=0; j<joint_names.size(); ++j )
+			{
+				if ( msg.name[i].compare(joint_names[j]) == 0 )
+				{
+					positions_[j] = msg.position[i];
+					valid_ = true;
+				}
+			}
+		}
+	}
+	condition_.notify_all();
+}
+
+double JointStateMonitor::getDeviation(const std::vector<double> &target) const
+{
+	double norm = 0.;
+	for ( size_t i=0; i<positions_.size(); ++i )
+	{
+		const double error = target[i]-positions_[i];
+		norm += error*error;  // sum over squared errors
+	}
+	return std::sqrt(norm);
+}
+
+bool JointStateMonitor::getState(std::vector<double> &state, const double timeout)
+{
+	const boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds((long)(timeout*1e6));
+	boost::mutex::scoped_lock lock(mutex_);
+	while ( !valid_ )
+		if ( !condition_.timed_wait(lock, deadline) && !valid_ )
+			return false;
+
+	state.assign(positions_.begin(), positions_.end());
+	return true;
+}
+
+bool JointStateMonitor::waitForState(const std::vector<double> &target, const double tolerance, const double timeout, double &deviation)
+{
+	const boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds((long)(timeout*1e6));
+	boost::mutex::scoped_lock lock(mutex_);
+	deviation = -1.;
+	while ( true )
+	{
+		if ( valid_ )
+		{
+			if ( positions_.size() != target.size() )
+			{
+				ROS_ERROR("JointStateMonitor::waitForState - Size of target configuration and count of joints do not match!");
+				return false;
+			}
+
+			deviation = getDeviation(target);
+			if ( deviation < tolerance )  // close enough to goal configuration
+				return true;
+		}
+
+		if ( !condition_.timed_wait(lock, deadline) )  // woken up by each new joint state
+		{
+			if ( valid_ && positions_.size() == target.size() )
+				deviation = getDeviation(target);
+			return ( deviation >= 0. && deviation < tolerance );
+		}
+	}
+}
+
+
+IPAInterface::IPAInterface() :
+				joint_state_spinner_(1, &joint_state_queue_)
 {
 }
 
 IPAInterface::IPAInterface(ros::NodeHandle* nh, CalibrationType* calib_type, CalibrationMarker* calib_marker, bool do_arm_calibration, bool load_data) :
-				CalibrationInterface(nh), calibration_type_(calib_type), calibration_marker_(calib_marker), arm_calibration_(do_arm_calibration), load_data_(load_data)
+				CalibrationInterface(nh), calibration_type_(calib_type), calibration_marker_(calib_marker), arm_calibration_(do_arm_calibration), load_data_(load_data),
+				joint_state_node_handle_(node_handle_), joint_state_spinner_(1, &joint_state_queue_)
 {
+	joint_state_node_handle_.setCallbackQueue(&joint_state_queue_);
+	joint_state_spinner_.start();
+
 	if ( !load_data_ )  // calibration_type holds code for moving the robot which is not needed in case of offline calibration
 	{
 		if ( calibration_type_ != 0 )
@@ -87,6 +182,8 @@ IPAInterface::IPAInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 
 IPAInterface::~IPAInterface()
 {
+	joint_state_spinner_.stop();
+
 	if ( calibration_type_ != 0 )
 		delete calibration_type_;
 
@@ -116,7 +213,7 @@ CalibrationInterface* IPAInterface::createInterfaceByID(int ID, ros::NodeHandle*
 bool IPAInterface::moveRobot(int config_index)
 {
 	if ( calibration_type_ != 0 )
-		return calibration_type_->moveRobot(config_index);
+		return calibration_type_->moveRobot(calibration_type_->getScheduledIndex(config_index));
 	else
 	{
 		ROS_ERROR("IPAInterface::moveRobot - Calibration type has not been created!");
@@ -135,9 +232,47 @@ int IPAInterface::getConfigurationCount()
 	}
 }
 
+bool IPAInterface::getConfigurationParameters(int config_index, std::vector<double> &parameters)
+{
+	if ( calibration_type_ != 0 )
+		return calibration_type_->getConfigurationParameters(calibration_type_->getScheduledIndex(config_index), parameters);
+	else
+	{
+		ROS_ERROR("IPAInterface::getConfigurationParameters - Calibration type has not been created!");
+		return false;
+	}
+}
+
+int IPAInterface::getScheduledIndex(int config_index)
+{
+	if ( calibration_type_ != 0 )
+		return calibration_type_->getScheduledIndex(config_index);
+	else
+	{
+		ROS_ERROR("IPAInterface::getScheduledIndex - Calibration type has not been created!");
+		return config_index;
+	}
+}
+
+bool IPAInterface::isTransitionFeasible(int from_index, int to_index)
+{
+	if ( calibration_type_ != 0 )
+		return calibration_type_->isTransitionFeasible(calibration_type_->getScheduledIndex(from_index), calibration_type_->getScheduledIndex(to_index));
+	else
+	{
+		ROS_ERROR("IPAInterface::isTransitionFeasible - Calibration type has not been created!");
+		return true;
+	}
+}
+
 void IPAInterface::preSnapshot(int current_index)
 {
-	ros::Duration(calibration_marker_->getWaitTime()).sleep();  // wait for markers being detected properly
+	// waiting for markers being detected properly is done by the settle detection of RobotCalibration, see getMaxSettleTime()
+}
+
+double IPAInterface::getMaxSettleTime()
+{
+	return calibration_marker_->getWaitTime();
 }
 
 // we are not making use of marker_frame, as we do either use pitags or checkerboards throughout the whole calibration, so we do not mix markers
@@ -185,3 +320,8 @@ std::string IPAInterface::getRobotName()
 {
 	return "IPA-Robot";
 }
+
+std::string IPAInterface::getKinematicChain(const std::string &actuator_name, const bool is_arm)
+{
+	return ( is_arm ? "arm/" : "camera/" ) + actuator_name;
+}
@@ -54,7 +54,7 @@
 
 
 RAWInterface::RAWInterface(ros::NodeHandle* nh, CalibrationType* calib_type, CalibrationMarker* calib_marker, bool do_arm_calibration, bool load_data) :
-				IPAInterface(nh, calib_type, calib_marker, do_arm_calibration, load_data), arm_state_current_(0), camera_state_current_(0),
+				IPAInterface(nh, calib_type, calib_marker, do_arm_calibration, load_data),
 				arm_action_client_("/arm/joint_trajectory_controller/follow_joint_trajectory", true),
 				camera_action_client_("/torso/joint_trajectory_controller/follow_joint_trajectory", true)
 {
@@ -65,19 +65,10 @@ RAWInterface::RAWInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 	std::cout << "camera_joint_controller_command: " << camera_joint_controller_command_ << std::endl;
 	camera_joint_controller_ = node_handle_.advertise<std_msgs::Float64MultiArray>(camera_joint_controller_command_, 1, false);
 
-	camera_state_current_ = new sensor_msgs::JointState;
-	if ( camera_state_current_ != 0 )
-	{
-		node_handle_.param<std::string>("camera_joint_state_topic", camera_joint_state_topic_, "");
-		std::cout << "camera_joint_state_topic: " << camera_joint_state_topic_ << std::endl;
-		camera_state_ = node_handle_.subscribe<sensor_msgs::JointState>(camera_joint_state_topic_, 0, &RAWInterface::cameraStateCallback, this);
-		camera_action_client_.waitForServer();
-	}
-	else
-	{
-		ROS_ERROR("RAWInterface::RAWInterface - Could not create current camera state storage!");
-		return;
-	}
+	node_handle_.param<std::string>("camera_joint_state_topic", camera_joint_state_topic_, "");
+	std::cout << "camera_joint_state_topic: " << camera_joint_state_topic_ << std::endl;
+	camera_state_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(camera_joint_state_topic_, 0, &RAWInterface::cameraStateCallback, this);
+	camera_action_client_.waitForServer();
 
 	if ( arm_calibration_ )
 	{
@@ -85,19 +76,10 @@ RAWInterface::RAWInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 		std::cout << "arm_joint_controller_command: " << arm_joint_controller_command_ << std::endl;
 		arm_joint_controller_ = node_handle_.advertise<trajectory_msgs::JointTrajectory>(arm_joint_controller_command_, 1, false);
 
-		arm_state_current_ = new sensor_msgs::JointState;
-		if ( arm_state_current_ != 0 )
-		{
-			node_handle_.param<std::string>("arm_state_topic", arm_state_topic_, "");
-			std::cout << "arm_state_topic: " << arm_state_topic_ << std::endl;
-			arm_state_ = node_handle_.subscribe<sensor_msgs::JointState>(arm_state_topic_, 0, &RAWInterface::armStateCallback, this);
-			arm_action_client_.waitForServer();
-		}
-		else
-		{
-			ROS_ERROR("RAWInterface::RAWInterface - Could not create current arm state storage!");
-			return;
-		}
+		node_handle_.param<std::string>("arm_state_topic", arm_state_topic_, "");
+		std::cout << "arm_state_topic: " << arm_state_topic_ << std::endl;
+		arm_state_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(arm_state_topic_, 0, &RAWInterface::armStateCallback, this);
+		arm_action_client_.waitForServer();
 	}
 	else
 	{
@@ -111,11 +93,9 @@ RAWInterface::RAWInterface(ros::NodeHandle* nh, CalibrationType* calib_type, Cal
 
 RAWInterface::~RAWInterface()
 {
-	if ( camera_state_current_ != 0 )
-		delete camera_state_current_;
-
-	if ( arm_state_current_ != 0 )
-		delete arm_state_current_;
+	// stop callbacks before the joint state storage is destroyed
+	camera_state_.shutdown();
+	arm_state_.shutdown();
 }
 
 
@@ -124,14 +104,12 @@ RAWInterface::~RAWInterface()
 //Callbacks - User defined
 void RAWInterface::cameraStateCallback(const sensor_msgs::JointState::ConstPtr& msg)
 {
-	boost::mutex::scoped_lock lock(camera_state_data_mutex_);
-	*camera_state_current_ = *msg;
+	camera_state_current_.update(msg->position);
 }
 
 void RAWInterface::armStateCallback(const sensor_msgs::JointState::ConstPtr& msg)
 {
-	boost::mutex::scoped_lock lock(arm_state_data_mutex_);
-	*arm_state_current_ = *msg;
+	arm_state_current_.update(msg->position);
 }
 // End Callbacks
 
@@ -170,10 +148,9 @@ void RAWInterface::assignNewCameraAngles(const std::string &camera_name, std_msg
 	camera_action_client_.sendGoal(camGoal);
 }
 
-std::vector<double>* RAWInterface::getCurrentCameraState(const std::string &camera_name)
+JointStateMonitor* RAWInterface::getCameraStateMonitor(const std::string &camera_name)
 {
-	boost::mutex::scoped_lock lock(camera_state_data_mutex_);
-	return &camera_state_current_->position;
+	return &camera_state_current_;
 }
 // END CALIBRATION INTERFACE
 
@@ -198,10 +175,9 @@ void RAWInterface::assignNewArmJoints(const std::string &arm_name, std_msgs::Flo
 	arm_action_client_.sendGoal(armGoal);
 }
 
-std::vector<double>* RAWInterface::getCurrentArmState(const std::string &arm_name)
+JointStateMonitor* RAWInterface::getArmStateMonitor(const std::string &arm_name)
 {
-	boost::mutex::scoped_lock lock(arm_state_data_mutex_);
-	return &arm_state_current_->position;
+	return &arm_state_current_;
 }
 // END
 
@@ -210,6 +186,15 @@ std::string RAWInterface::getRobotName()
 	return "RAW-3-1";
 }
 
+std::string RAWInterface::getKinematicChain(const std::string &actuator_name, const bool is_arm)
+{
+	// the realsense camera is mounted on the arm and moved by the arm joints, see assignNewCameraAngles()
+	if ( is_arm || actuator_name.compare("realsense_sr300") == 0 )
+		return "arm";
+
+	return IPAInterface::getKinematicChain(actuator_name, is_arm);
+}
+
 
 
 
@@ -52,7 +52,7 @@
 
 
 RobotinoInterface::RobotinoInterface(ros::NodeHandle* nh, CalibrationType* calib_type, CalibrationMarker* calib_marker, bool do_arm_calibration, bool load_data) :
-				IPAInterface(nh, calib_type, calib_marker, do_arm_calibration, load_data), camera_state_current_(2, 0.), arm_state_current_(0)
+				IPAInterface(nh, calib_type, calib_marker, do_arm_calibration, load_data), camera_joint_names_(2)
 {
 	std::cout << "\n========== RobotinoInterface Parameters ==========\n";
 
@@ -66,12 +66,12 @@ RobotinoInterface::RobotinoInterface(ros::NodeHandle* nh, CalibrationType* calib
 
 	node_handle_.param<std::string>("camera_joint_state_topic", camera_joint_state_topic_, "");
 	std::cout << "camera_joint_state_topic: " << camera_joint_state_topic_ << std::endl;
-	node_handle_.param<std::string>("pan_joint_name", pan_joint_name_, "");
-	std::cout << "pan_joint_name: " << pan_joint_name_ << std::endl;
-	node_handle_.param<std::string>("tilt_joint_name", tilt_joint_name_, "");
-	std::cout << "tilt_joint_name: " << tilt_joint_name_ << std::endl;
+	node_handle_.param<std::string>("pan_joint_name", camera_joint_names_[0], "");
+	std::cout << "pan_joint_name: " << camera_joint_names_[0] << std::endl;
+	node_handle_.param<std::string>("tilt_joint_name", camera_joint_names_[1], "");
+	std::cout << "tilt_joint_name: " << camera_joint_names_[1] << std::endl;
 
-	camera_joint_state_sub_ = node_handle_.subscribe<sensor_msgs::JointState>(camera_joint_state_topic_, 0, &RobotinoInterface::cameraJointStateCallback, this);
+	camera_joint_state_sub_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(camera_joint_state_topic_, 0, &RobotinoInterface::cameraJointStateCallback, this);
 
 	if ( arm_calibration_ )
 	{
@@ -81,7 +81,7 @@ RobotinoInterface::RobotinoInterface(ros::NodeHandle* nh, CalibrationType* calib
 
 		node_handle_.param<std::string>("arm_state_topic", arm_state_topic_, "");
 		std::cout << "arm_state_topic: " << arm_state_topic_ << std::endl;
-		arm_state_ = node_handle_.subscribe<sensor_msgs::JointState>(arm_state_topic_, 0, &RobotinoInterface::armStateCallback, this);
+		arm_state_ = joint_state_node_handle_.subscribe<sensor_msgs::JointState>(arm_state_topic_, 0, &RobotinoInterface::armStateCallback, this);
 	}
 	else
 	{
@@ -95,6 +95,9 @@ RobotinoInterface::RobotinoInterface(ros::NodeHandle* nh, CalibrationType* calib
 
 RobotinoInterface::~RobotinoInterface()
 {
+	// stop callbacks before the joint state storage is destroyed
+	camera_joint_state_sub_.shutdown();
+	arm_state_.shutdown();
 }
 
 
@@ -103,25 +106,12 @@ RobotinoInterface::~RobotinoInterface()
 //Callbacks - User defined
 void RobotinoInterface::cameraJointStateCallback(const sensor_msgs::JointState::ConstPtr& msg)
 {
-	boost::mutex::scoped_lock lock(camera_state_data_mutex_);
-	if (camera_state_current_.size() >= 2)
-	{
-		for (size_t i=0; i<msg->name.size(); ++i)
-		{
-			const std::string& name = msg->name[i];
-			if (name.compare(pan_joint_name_)==0)
-				camera_state_current_[0] = msg->position[i];
-			if (name.compare(tilt_joint_name_)==0)
-				camera_state_current_[1] = msg->position[i];
-		}
-	}
+	camera_state_current_.update(*msg, camera_joint_names_);
 }
 
 void RobotinoInterface::armStateCallback(const sensor_msgs::JointState::ConstPtr& msg)
 {
-	boost::mutex::scoped_lock lock(arm_state_data_mutex_);
-	arm_state_current_ = new sensor_msgs::JointState;
-	*arm_state_current_ = *msg;
+	arm_state_current_.update(msg->position);
 }
 // End Callbacks
 
@@ -141,9 +131,8 @@ void RobotinoInterface::assignNewCameraAngles(const std::string &camera_name, st
 	tilt_controller_.publish(angle);
 }
 
-std::vector<double>* RobotinoInterface::getCurrentCameraState(const std::string &camera_name)
+JointStateMonitor* RobotinoInterface::getCameraStateMonitor(const std::string &camera_name)
 {
-	boost::mutex::scoped_lock lock(camera_state_data_mutex_);
 	return &camera_state_current_;
 }
 // END CALIBRATION INTERFACE
@@ -156,10 +145,9 @@ void RobotinoInterface::assignNewArmJoints(const std::string &arm_name, std_msgs
 	arm_joint_controller_.publish(new_joint_config);
 }
 
-std::vector<double>* RobotinoInterface::getCurrentArmState(const std::string &arm_name)
+JointStateMonitor* RobotinoInterface::getArmStateMonitor(const std::string &arm_name)
 {
-	boost::mutex::scoped_lock lock(arm_state_data_mutex_);
-	return &arm_state_current_->position;
+	return &arm_state_current_;
 }
 // END
 
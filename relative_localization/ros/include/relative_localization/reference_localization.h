@@ -66,6 +66,7 @@
 
 // messages
 #include <sensor_msgs/LaserScan.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
 #include <visualization_msgs/Marker.h>
 #include <std_msgs/Header.h>
 
@@ -81,6 +82,8 @@
 // OpenCV
 #include <opencv2/opencv.hpp>
 
+#include <robotino_calibration/pose_filter.h>
+
 
 class ReferenceLocalization
 {
@@ -104,23 +107,25 @@ protected:
 	// only works for laser scanners mounted parallel to the ground, assuming that laser scanner frame and base_link have the same z-axis
 	void shiftReferenceFrameToGround(tf::StampedTransform& reference_frame);
 
+	// reads a [translation, rotation] pair of filter parameters
+	void loadFilterParameter(const std::string& name, const double default_translation, const double default_rotation, double* value);
+
 
 	bool initialized_;
 
 	ros::NodeHandle node_handle_;
 	ros::Subscriber laser_scan_sub_;
 	ros::Publisher marker_pub_;
+	ros::Publisher pose_pub_;
 
 	tf::TransformBroadcaster transform_broadcaster_;
 	tf::TransformListener transform_listener_;
 
 	dynamic_reconfigure::Server<robotino_calibration::RelativeLocalizationConfig> dynamic_reconfigure_server_;
-	tf::Vector3 avg_translation_;
-	tf::Quaternion avg_orientation_;
+	PoseFilter pose_filter_;
 	double base_height_;
 
 	// parameters
-	double update_rate_;
 	std::string base_frame_;
 	std::string laser_scanner_topic_in_;
 	std::string reference_frame_;
@@ -65,8 +65,14 @@ ReferenceLocalization::ReferenceLocalization(ros::NodeHandle& nh)
 {
 	// load parameters
 	std::cout << "\n========== Reference Localization Parameters ==========\n";
-	node_handle_.param("update_rate", update_rate_, 0.75);
-	std::cout << "update_rate: " << update_rate_ << std::endl;
+	// the base is servoed on the reference frame while it moves, so the process noise has to cover the base motion of ~0.05 m/s
+	double measurement_std[2], process_std[2];  // [translation, rotation]
+	loadFilterParameter("filter_measurement_std", 0.005, 0.01, measurement_std);
+	loadFilterParameter("filter_process_std", 0.02, 0.02, process_std);
+	double innovation_gate;
+	node_handle_.param("filter_innovation_gate", innovation_gate, 11.34);
+	std::cout << "filter_innovation_gate: " << innovation_gate << std::endl;
+	pose_filter_ = PoseFilter(measurement_std[0], measurement_std[1], process_std[0], process_std[1], innovation_gate);
 	node_handle_.param<std::string>("reference_frame", reference_frame_, "");
 	std::cout << "reference_frame: " << reference_frame_ << std::endl;
 	node_handle_.param<std::string>("laser_scanner_topic_in", laser_scanner_topic_in_, "");
@@ -94,13 +100,13 @@ ReferenceLocalization::ReferenceLocalization(ros::NodeHandle& nh)
 
 	// publishers
 	marker_pub_ = node_handle_.advertise<visualization_msgs::Marker>("wall_marker", 1);
+	pose_pub_ = node_handle_.advertise<geometry_msgs::PoseWithCovarianceStamped>("reference_pose", 1);
 
 	// subscribers
 	laser_scan_sub_ = node_handle_.subscribe(laser_scanner_topic_in_, 0, &ReferenceLocalization::callback, this);
 
 	// dynamic reconfigure
 	dynamic_reconfigure_server_.setCallback(boost::bind(&ReferenceLocalization::dynamicReconfigureCallback, this, _1, _2));
-	avg_translation_.setZero();
 
 	ROS_INFO("ReferenceLocalization::ReferenceLocalization - Initialized.");
 }
@@ -109,12 +115,19 @@ ReferenceLocalization::~ReferenceLocalization()
 {
 }
 
+void ReferenceLocalization::loadFilterParameter(const std::string& name, const double default_translation, const double default_rotation, double* value)
+{
+	std::vector<double> temp;
+	node_handle_.getParam(name, temp);
+	value[0] = (temp.size() == 2 ? temp[0] : default_translation);
+	value[1] = (temp.size() == 2 ? temp[1] : default_rotation);
+	std::cout << name << ": [" << value[0] << ", " << value[1] << "]" << std::endl;
+}
+
 void ReferenceLocalization::dynamicReconfigureCallback(robotino_calibration::RelativeLocalizationConfig &config, uint32_t level)
 {
-	update_rate_ = config.update_rate;
 	reference_frame_ = config.reference_frame;
-	std::cout << "Reconfigure request with\n update_rate=" << update_rate_
-			<< "\n reference_frame=" << reference_frame_ << "\n";
+	std::cout << "Reconfigure request with\n reference_frame=" << reference_frame_ << "\n";
 }
 
 bool ReferenceLocalization::estimateFrontWall(std::vector<cv::Point2d>& scan_front, cv::Vec4d& line_front, const double inlier_ratio, const double success_probability,
@@ -189,30 +202,26 @@ void ReferenceLocalization::computeAndPublishChildFrame(const cv::Vec4d& line, c
 	double angle = atan2(normal.y, normal.x);
 	tf::Quaternion orientation(tf::Vector3(0,0,1), angle); // rotation around z by value of angle
 
-	// update transform
-	if (avg_translation_.isZero())
-	{
-		// use value directly on first message
-		avg_translation_ = translation;
-		avg_orientation_ = orientation;
-	}
-	else
-	{
-		// update value
-		avg_translation_ = (1.0 - update_rate_) * avg_translation_ + update_rate_ * translation;
-		avg_orientation_.setW((1.0 - update_rate_) * avg_orientation_.getW() + update_rate_ * orientation.getW());
-		avg_orientation_.setX((1.0 - update_rate_) * avg_orientation_.getX() + update_rate_ * orientation.getX());
-		avg_orientation_.setY((1.0 - update_rate_) * avg_orientation_.getY() + update_rate_ * orientation.getY());
-		avg_orientation_.setZ((1.0 - update_rate_) * avg_orientation_.getZ() + update_rate_ * orientation.getZ());
-	}
+	// update transform, the filter weights the measurement by the time since the last scan and follows steps of the wall quickly
+	pose_filter_.update(translation, orientation, time_stamp.toSec());
 
 	// transform
-	transform_table_reference.setOrigin(avg_translation_);
-	transform_table_reference.setRotation(avg_orientation_);
+	const tf::Transform filtered_transform = pose_filter_.getTransform();
+	transform_table_reference.setOrigin(filtered_transform.getOrigin());
+	transform_table_reference.setRotation(filtered_transform.getRotation());
 	tf::StampedTransform tf_msg(transform_table_reference, time_stamp, base_frame_, reference_frame_);
 	shiftReferenceFrameToGround(tf_msg);
 
-	// publish coordinate system on tf
+	// publish the estimate with its uncertainty
+	geometry_msgs::PoseWithCovarianceStamped pose_msg;
+	pose_msg.header.stamp = time_stamp;
+	pose_msg.header.frame_id = base_frame_;
+	tf::poseTFToMsg(tf_msg, pose_msg.pose.pose);
+	pose_filter_.getCovariance(&pose_msg.pose.covariance[0], time_stamp.toSec());
+	pose_pub_.publish(pose_msg);
+
+	// publish coordinate system on tf with every scan as the base is servoed on it, the convergence of the filter can be judged
+	// from the covariance on reference_pose
 	if (publish_tf == true)
 	{
 		transform_broadcaster_.sendTransform(tf_msg);
@@ -56,14 +56,15 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <fstream>
+#include <robotino_calibration/frame_registry.h>
 
 
 struct CalibrationInfo  // defines one uncertain transform in the kinematic chain
 {
-    std::string parent_;  // parent frame: start point of the vector
-    std::string child_;  // child frame: end point of the vector
-	std::vector<std::string> parent_markers_;  // marker frame one reaches from parent_ frame backwards
-	std::vector<std::string> child_markers_;  // marker_frame one reaches from child_ frame onwards
+    FrameId parent_;  // parent frame: start point of the vector
+    FrameId child_;  // child frame: end point of the vector
+	std::vector<FrameId> parent_markers_;  // marker frame one reaches from parent_ frame backwards
+	std::vector<FrameId> child_markers_;  // marker_frame one reaches from child_ frame onwards
     cv::Mat current_trafo_;
     bool calibrated_;  // marks whether this uncertainty has already been calibrated
 	bool parent_branch_uncertainty_;  // defines where this uncertainty lies: on parent- or child-branch
@@ -71,17 +72,21 @@ struct CalibrationInfo  // defines one uncertain transform in the kinematic chai
 
 struct CalibrationSetup  // defines one calibration setup, consisting of x transforms to be calibrated via parent and child marker
 {
-	std::string origin_;  // this is not the robot's base, but the frame where two transformations chains meet
+	FrameId origin_;  // this is not the robot's base, but the frame where two transformations chains meet
 	std::vector<CalibrationInfo> uncertainties_list_;  // unsorted list of uncertainties
-	std::vector<std::string> parent_branch_;  // contains all frames from origin up to the last parent-branch uncertainty's child
-	std::vector<std::string> child_branch_;  // contains all frames from origin up to the last child-branch uncertainty's child
+	std::vector<FrameId> parent_branch_;  // contains all frames from origin up to the last parent-branch uncertainty's child
+	std::vector<FrameId> child_branch_;  // contains all frames from origin up to the last child-branch uncertainty's child
 };
 
 struct TFInfo  // used to make snapshots from tf tree
 {
-	std::string parent_;
-	std::string child_;
+	FrameId parent_;
+	FrameId child_;
 	cv::Mat transform_;
+	double translation_variance_;  // spread of the averaged tf samples around transform_ [m^2], 0 if only one sample has been taken
+	double rotation_variance_;  // [rad^2]
+
+	TFInfo() : parent_(-1), child_(-1), translation_variance_(0.0), rotation_variance_(0.0) {}
 };
 
 // Used to snapshot the tf transform between the last frame of a branch to the corresponding markers
@@ -124,11 +129,11 @@ namespace file_utilities
 
 	void saveCalibrationSetups(const std::vector<CalibrationSetup> &calibration_setups, const std::string &save_path, const std::string &file_name);
 
-	void formatStringVector(std::stringstream &stream, const std::vector<std::string> string_vector);
+	void formatFrameVector(std::stringstream &stream, const std::vector<FrameId> &frame_vector);
 
 	bool loadCalibrationSetups(std::vector<CalibrationSetup> &calibration_setups, const std::string &load_path, const std::string &file_name);
 
-	void buildStringVector(std::fstream &file, std::vector<std::string> &string_vector);
+	void buildFrameVector(std::fstream &file, std::vector<FrameId> &frame_vector);
 
 }
 
@@ -0,0 +1,93 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#ifndef FRAME_REGISTRY_H_
+#define FRAME_REGISTRY_H_
+
+
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <map>
+#include <string>
+
+
+typedef int FrameId;  // compact id of an interned tf frame name, -1 = no frame
+
+
+// Process-wide table of tf frame names. Calibration setups and snapshots store frames as FrameIds,
+// so copying them does not copy strings and comparing frames is an integer comparison.
+// Ids are assigned in order of first occurrence and stay valid for the lifetime of the process.
+class FrameRegistry
+{
+public:
+
+	static FrameId intern(const std::string &frame);  // returns the id of frame, registers it if it is not known yet
+
+	static FrameId find(const std::string &frame);  // -1 if frame has not been registered
+
+	static const std::string& name(const FrameId id);  // empty string for unknown ids, the reference stays valid
+
+	static int size();
+
+
+protected:
+
+	FrameRegistry();
+
+	static FrameRegistry& instance();
+
+	boost::mutex mutex_;
+	std::map<std::string, FrameId> ids_;
+	std::deque<std::string> names_;  // deque, so that references handed out by name() survive new registrations
+};
+
+
+#endif /* FRAME_REGISTRY_H_ */
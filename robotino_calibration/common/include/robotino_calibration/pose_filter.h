@@ -0,0 +1,107 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#ifndef POSE_FILTER_H_
+#define POSE_FILTER_H_
+
+
+#include <tf/tf.h>
+
+
+// Temporal filter for a pose that is constant apart from slow drift, observed by noisy measurements, e.g. a detected marker.
+// It is a Kalman filter with isotropic translation and rotation variances: the orientation is blended by slerp and stays a
+// unit quaternion, and the blend weight follows from the variances and the elapsed time instead of a fixed update rate.
+// A measurement that is implausible for the current uncertainty (normalized innovation squared above a chi-square gate, e.g.
+// after the robot moved) inflates the variances until it fits, so the estimate follows the step within a few measurements.
+class PoseFilter
+{
+
+protected:
+
+	double measurement_variance_translation_;  // [m^2]
+	double measurement_variance_rotation_;  // [rad^2]
+	double process_variance_translation_;  // [m^2/s]
+	double process_variance_rotation_;  // [rad^2/s]
+	double innovation_gate_;  // chi-square threshold on the normalized innovation squared, 3 degrees of freedom each for translation and rotation
+
+	bool initialized_;
+	double last_time_;  // [s]
+	tf::Vector3 translation_;
+	tf::Quaternion orientation_;
+	double variance_translation_;
+	double variance_rotation_;
+
+	void predictVariances(const double time, double &variance_translation, double &variance_rotation) const;  // variances at time, without a new measurement
+
+
+public:
+
+	// standard deviations of a single measurement and of the drift per sqrt(second). the default gate accepts 99% of the measurements
+	PoseFilter(const double measurement_std_translation=0.005, const double measurement_std_rotation=0.01, const double process_std_translation=0.001,
+			   const double process_std_rotation=0.002, const double innovation_gate=11.34);
+
+	void reset();
+	void update(const tf::Vector3 &translation, const tf::Quaternion &orientation, const double time);  // time of the measurement in [s]
+
+	bool isInitialized() const;
+
+	// the uncertainty queries predict the variances up to the given time [s], so an estimate that receives no more measurements
+	// does not stay certain forever
+	bool isConverged(const double max_std_translation, const double max_std_rotation, const double time) const;  // both standard deviations below the given ones
+
+	tf::Transform getTransform() const;
+	double getStdTranslation(const double time) const;  // [m]
+	double getStdRotation(const double time) const;  // [rad]
+	void getCovariance(double* covariance, const double time) const;  // row-major 6x6 covariance of (x, y, z, roll, pitch, yaw), as used in geometry_msgs
+};
+
+
+#endif /* POSE_FILTER_H_ */
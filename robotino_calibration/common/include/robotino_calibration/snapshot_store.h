@@ -0,0 +1,109 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#ifndef SNAPSHOT_STORE_H_
+#define SNAPSHOT_STORE_H_
+
+
+#include <robotino_calibration/file_utilities.h>
+#include <string>
+#include <vector>
+
+
+// Binary container for tf snapshots used for offline calibration, replaces the text format of file_utilities::saveSnapshots.
+// Layout (native byte order, all integers 32 bit):
+//   header:       magic "RCALSNAP", version, byte order mark
+//   frame table:  frame count, per frame: name length, name characters (no terminator)
+//   data:         configuration count, per configuration: setup count, per setup one snapshot record
+//   snapshot:     valid flag, marker list count, per marker list: uncertainty index, child marker count, parent marker count and their tf records,
+//                 then parent-branch count and tf records, child-branch count and tf records
+//   tf record:    parent frame id, child frame id, has transform flag, 16 doubles of the 4x4 transform and the translation and rotation
+//                 variance (only if flag is set, version 1 files have no variances)
+// Transforms are stored as raw doubles, so saving and loading is lossless.
+namespace snapshot_store
+{
+
+	bool saveSnapshots(const std::vector< std::vector<TFSnapshot> > &snapshots, const std::string &file_path);
+
+	// memory-maps the file and decodes it, returns false if the file does not exist or is corrupted
+	bool loadSnapshots(std::vector< std::vector<TFSnapshot> > &snapshots, const std::string &file_path);
+
+	// Append-only journal that stores the snapshots of each robot configuration as soon as they have been captured.
+	// Each record holds the configuration index, its own frame table and a checksum; it is flushed to disk before append() returns,
+	// so a crash loses at most the configuration that was being written.
+	class SnapshotJournal
+	{
+	public:
+
+		SnapshotJournal();
+		~SnapshotJournal();
+
+		// starts a new journal, or continues an existing one after its last complete record if resume is set.
+		// without resume an existing journal is kept as <file_path>.bak (replacing an older backup)
+		bool open(const std::string &file_path, const bool resume);
+
+		// an empty snapshots vector records a configuration that has been visited without producing data
+		bool append(const int configuration_idx, const std::vector<TFSnapshot> &snapshots);
+
+		void close();
+
+	protected:
+
+		int fd_;
+	};
+
+	// reads all complete records of a journal, returns false if the file does not exist or is no journal
+	bool loadJournal(const std::string &file_path, std::vector<int> &configuration_indices, std::vector< std::vector<TFSnapshot> > &snapshots);
+
+}
+
+
+#endif /* SNAPSHOT_STORE_H_ */
@@ -58,6 +58,13 @@
 
 namespace transform_utilities
 {
+	// fixed-size rigid transform [R|t], stored row-major as the upper 3x4 block of a 4x4 transformation matrix (last row 0,0,0,1 is implicit)
+	// used by the calibration solver to avoid heap allocations of cv::Mat objects in its inner loops
+	struct RigidTransform
+	{
+		double data_[12];
+	};
+
 	// compute rotation matrix from yaw, pitch, roll
 	// (w, p, r) = (yaW, Pitch, Roll) with
 	// 1. rotation = yaw around z
@@ -75,10 +82,93 @@ namespace transform_utilities
 	// computes the transform from target_frame to source_frame (i.e. transform arrow is pointing from target_frame to source_frame)
 	bool getTransform(const tf::TransformListener& transform_listener, const std::string& target_frame, const std::string& source_frame, cv::Mat& T, const double timeout = 0.0, const bool report_error = true);
 
+	// looks up all transforms (target frame, source frame) at one common time stamp, so that they describe the same instant.
+	// The stamp is the latest time at which every transform is available, transforms whose latest data is older than timeout seconds
+	// are not taken into account and returned empty. Waits up to max_wait seconds for required transforms to become available.
+	// Returns false if a required transform can not be looked up.
+	bool getTransformsAtCommonTime(const tf::TransformListener& transform_listener, const std::vector< std::pair<std::string, std::string> >& frames,
+			const std::vector<bool>& required, const double timeout, const double max_wait, std::vector<cv::Mat>& transforms, ros::Time& stamp);
+
+	// conversions between 4x4 cv::Mat transforms (CV_64FC1) and fixed-size rigid transforms
+	void matToRigidTransform(const cv::Mat& T, RigidTransform& rigid);
+	cv::Mat rigidTransformToMat(const RigidTransform& rigid);
+
+	void setIdentity(RigidTransform& T);
+
+	// AB = A*B, AB must not alias A or B
+	void composeTransforms(const RigidTransform& A, const RigidTransform& B, RigidTransform& AB);
+
+	// T_inv = T^-1, T_inv must not alias T
+	void invertTransform(const RigidTransform& T, RigidTransform& T_inv);
+
+	// builds the rigid transform [Exp(w)|v] from a 6d increment (vx, vy, vz, wx, wy, wz), the rotation is computed with Rodrigues' formula
+	void twistToRigidTransform(const double* twist, RigidTransform& T);
+
+	// applies T to count points given as structure of arrays (x, y, z) and writes the transformed points to out
+	// processes four points at once if the library has been built with AVX2 (cmake option USE_AVX2), otherwise a scalar loop is used
+	void transformPoints(const RigidTransform& T, const double* x, const double* y, const double* z, const int count, cv::Point3d* out);
+
+	// computes the translational distance [m] and the rotation angle [rad] between two rigid transforms
+	void transformDifference(const RigidTransform& A, const RigidTransform& B, double& translation_delta, double& rotation_delta);
+
+	// fuses several samples of the same transform (empty samples are ignored): the rotation is the quaternion average, the translation
+	// the component-wise median. The mean squared deviation of the samples from the result is returned for translation [m^2] and rotation [rad^2].
+	// Returns false if there is no sample.
+	bool averageTransforms(const std::vector<cv::Mat>& samples, cv::Mat& T, double& translation_variance, double& rotation_variance);
+
+	enum RobustLoss
+	{
+		LOSS_NONE = 0,  // plain least squares on the inlier groups
+		LOSS_HUBER,
+		LOSS_CAUCHY
+	};
+
+	// streaming version of computeExtrinsicTransform: correspondences are pushed one by one, only their (weighted) sums are kept,
+	// so that neither the point sets nor temporary matrices have to be allocated
+	class ExtrinsicAccumulator
+	{
+	public:
+
+		ExtrinsicAccumulator();
+
+		void reset();
+
+		void add(const cv::Point3d& point_source, const cv::Point3d& point_target, const double weight = 1.0);
+
+		int getCount() const;  // number of added correspondences
+
+		void getCentroids(cv::Point3d& centroid_source, cv::Point3d& centroid_target) const;
+
+		// M = sum w*(p_target-centroid_target)*(p_source-centroid_source)^T, row-major
+		void getCrossCovariance(double* M) const;
+
+		// solves for the rigid transform that converts point coordinates from the target system into the source coordinate system
+		// with Horn's quaternion method, returns false if no correspondences have been added
+		bool computeTransform(RigidTransform& T) const;
+
+	protected:
+
+		int count_;
+		double weight_sum_;
+		double sum_source_[3];  // sum w*p_source
+		double sum_target_[3];  // sum w*p_target
+		double sum_target_source_[9];  // sum w*p_target*p_source^T, row-major
+	};
+
 	// computes the rigid transform between two sets of corresponding 3d points measured in different coordinate systems
 	// the resulting 4x4 transformation matrix converts point coordinates from the target system into the source coordinate system
 	cv::Mat computeExtrinsicTransform(const std::vector<cv::Point3d>& points_3d_source, const std::vector<cv::Point3d>& points_3d_target);
 
+	// robust version of computeExtrinsicTransform for correspondences that come in groups (e.g. all points of one snapshot),
+	// group i consists of the points [group_begin[i], group_begin[i+1]). RANSAC over groups: each hypothesis is fitted to a single group and a
+	// group counts as inlier if its RMS point distance is below inlier_threshold [m]. The best hypothesis is then refined on its inlier groups
+	// with iteratively reweighted least squares using the given loss (scale inlier_threshold). If no group ends up as inlier, all groups are kept
+	// and T is their plain least squares fit. Returns false if no group has 3 or more points.
+	// If weights are given (one per correspondence), the loss weights are multiplied by them.
+	bool computeRobustExtrinsicTransform(const std::vector<cv::Point3d>& points_3d_source, const std::vector<cv::Point3d>& points_3d_target,
+			const std::vector<int>& group_begin, const RobustLoss loss, const double inlier_threshold, const int max_hypotheses,
+			RigidTransform& T, std::vector<bool>& group_inliers, const std::vector<double>* weights = 0);
+
 }
 
 #endif	// _TRANSFORMATION_UTILITIES_H_
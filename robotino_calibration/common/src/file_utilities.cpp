@@ -91,7 +91,7 @@ namespace file_utilities
 		for ( int i=0; i<snapshots.size(); ++i )  // go through robot setups (each robot config has a snapshot for each calibration setup)
 		{
 			stream << "a{" << std::endl;
-			for ( TFSnapshot snap : snapshots[i] )  // go through calibration setups
+			for ( const TFSnapshot &snap : snapshots[i] )  // go through calibration setups
 			{
 				stream << "b{" << std::endl;
 				formatBETMs(stream, snap.branch_ends_to_markers_);
@@ -126,7 +126,7 @@ namespace file_utilities
 
 	void formatTFInfos(std::stringstream &stream, const std::vector<TFInfo> &TFInfos)
 	{
-		for ( TFInfo info : TFInfos )
+		for ( const TFInfo &info : TFInfos )
 		{
 			std::string trafo = trafoToString(info.transform_);
 
@@ -136,7 +136,7 @@ namespace file_utilities
 				return;
 			}
 
-			stream << info.parent_ << std::endl << info.child_ << std::endl << trafo << std::endl;
+			stream << FrameRegistry::name(info.parent_) << std::endl << FrameRegistry::name(info.child_) << std::endl << trafo << std::endl;
 		}
 		stream << "{}" << std::endl;
 	}
@@ -247,8 +247,9 @@ namespace file_utilities
 			{
 				TFInfo info;
 
-				info.parent_ = line;
-				std::getline(file, info.child_);
+				info.parent_ = FrameRegistry::intern(line);
+				std::getline(file, line);
+				info.child_ = FrameRegistry::intern(line);
 				std::string trafo = "";
 				std::getline(file, trafo);
 				stringToTrafo(trafo, info.transform_);
@@ -301,22 +302,22 @@ namespace file_utilities
 		for ( int i=0; i<calibration_setups.size(); ++i )
 		{
 			stream << "1{" << std::endl;
-			stream << calibration_setups[i].origin_ << std::endl;
+			stream << FrameRegistry::name(calibration_setups[i].origin_) << std::endl;
 
-			for ( CalibrationInfo info : calibration_setups[i].uncertainties_list_ )
+			for ( const CalibrationInfo &info : calibration_setups[i].uncertainties_list_ )
 			{
 				stream << "2{" << std::endl;
-				stream << info.parent_ << std::endl;
-				stream << info.child_ << std::endl;
-				formatStringVector(stream, info.parent_markers_);
-				formatStringVector(stream, info.child_markers_);
+				stream << FrameRegistry::name(info.parent_) << std::endl;
+				stream << FrameRegistry::name(info.child_) << std::endl;
+				formatFrameVector(stream, info.parent_markers_);
+				formatFrameVector(stream, info.child_markers_);
 				stream << trafoToString(info.current_trafo_) << std::endl;
 				stream << info.parent_branch_uncertainty_ << std::endl;
 			}
 
 			stream << "2}" << std::endl;
-			formatStringVector(stream, calibration_setups[i].parent_branch_);
-			formatStringVector(stream, calibration_setups[i].child_branch_);
+			formatFrameVector(stream, calibration_setups[i].parent_branch_);
+			formatFrameVector(stream, calibration_setups[i].child_branch_);
 		}
 
 		std::fstream file_output;
@@ -329,10 +330,10 @@ namespace file_utilities
 		file_output.close();
 	}
 
-	void formatStringVector(std::stringstream &stream, const std::vector<std::string> string_vector)
+	void formatFrameVector(std::stringstream &stream, const std::vector<FrameId> &frame_vector)
 	{
-		for ( std::string str : string_vector )
-			stream << str << std::endl;
+		for ( FrameId frame : frame_vector )
+			stream << FrameRegistry::name(frame) << std::endl;
 
 		stream << "{}" << std::endl;
 	}
@@ -354,7 +355,8 @@ namespace file_utilities
 				{
 					CalibrationSetup setup;
 
-					std::getline(file_input, setup.origin_);
+					std::getline(file_input, line);
+					setup.origin_ = FrameRegistry::intern(line);
 					bool corrupted = true;
 
 					while ( !file_input.eof() )
@@ -366,10 +368,12 @@ namespace file_utilities
 						{
 							CalibrationInfo info;
 
-							std::getline(file_input, info.parent_);
-							std::getline(file_input, info.child_);
-							buildStringVector(file_input, info.parent_markers_);
-							buildStringVector(file_input, info.child_markers_);
+							std::getline(file_input, line);
+							info.parent_ = FrameRegistry::intern(line);
+							std::getline(file_input, line);
+							info.child_ = FrameRegistry::intern(line);
+							buildFrameVector(file_input, info.parent_markers_);
+							buildFrameVector(file_input, info.child_markers_);
 							std::string trafo = "";
 							std::getline(file_input, trafo);
 							stringToTrafo(trafo, info.current_trafo_);
@@ -382,8 +386,8 @@ namespace file_utilities
 						}
 						else if ( line.compare("2}") == 0 )
 						{
-							buildStringVector(file_input, setup.parent_branch_);
-							buildStringVector(file_input, setup.child_branch_);
+							buildFrameVector(file_input, setup.parent_branch_);
+							buildFrameVector(file_input, setup.child_branch_);
 							corrupted = false;
 							break;
 						}
@@ -404,7 +408,7 @@ namespace file_utilities
 		return result;
 	}
 
-	void buildStringVector(std::fstream &file, std::vector<std::string> &string_vector)
+	void buildFrameVector(std::fstream &file, std::vector<FrameId> &frame_vector)
 	{
 		while ( !file.eof() )
 		{
@@ -414,7 +418,7 @@ namespace file_utilities
 			if ( line.compare("{}") == 0 )
 				break;
 			else
-				string_vector.push_back(line);
+				frame_vector.push_back(FrameRegistry::intern(line));
 		}
 	}
 }
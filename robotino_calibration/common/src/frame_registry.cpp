@@ -0,0 +1,103 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#include <robotino_calibration/frame_registry.h>
+
+
+FrameRegistry::FrameRegistry()
+{
+}
+
+FrameRegistry& FrameRegistry::instance()
+{
+	static FrameRegistry registry;
+	return registry;
+}
+
+FrameId FrameRegistry::intern(const std::string &frame)
+{
+	FrameRegistry &registry = instance();
+	boost::mutex::scoped_lock lock(registry.mutex_);
+
+	std::map<std::string, FrameId>::const_iterator it = registry.ids_.find(frame);
+	if ( it != registry.ids_.end() )
+		return it->second;
+
+	const FrameId id = registry.names_.size();
+	registry.ids_[frame] = id;
+	registry.names_.push_back(frame);
+	return id;
+}
+
+FrameId FrameRegistry::find(const std::string &frame)
+{
+	FrameRegistry &registry = instance();
+	boost::mutex::scoped_lock lock(registry.mutex_);
+
+	std::map<std::string, FrameId>::const_iterator it = registry.ids_.find(frame);
+	return ( it != registry.ids_.end() ? it->second : -1 );
+}
+
+const std::string& FrameRegistry::name(const FrameId id)
+{
+	static const std::string unknown = "";
+
+	FrameRegistry &registry = instance();
+	boost::mutex::scoped_lock lock(registry.mutex_);
+	return ( id >= 0 && id < registry.names_.size() ? registry.names_[id] : unknown );
+}
+
+int FrameRegistry::size()
+{
+	FrameRegistry &registry = instance();
+	boost::mutex::scoped_lock lock(registry.mutex_);
+	return registry.names_.size();
+}
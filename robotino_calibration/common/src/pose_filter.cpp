@@ -0,0 +1,168 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#include <robotino_calibration/pose_filter.h>
+#include <algorithm>
+#include <cmath>
+
+
+PoseFilter::PoseFilter(const double measurement_std_translation, const double measurement_std_rotation, const double process_std_translation,
+					   const double process_std_rotation, const double innovation_gate) :
+		measurement_variance_translation_(measurement_std_translation*measurement_std_translation),
+		measurement_variance_rotation_(measurement_std_rotation*measurement_std_rotation),
+		process_variance_translation_(process_std_translation*process_std_translation),
+		process_variance_rotation_(process_std_rotation*process_std_rotation),
+		innovation_gate_(innovation_gate)
+{
+	reset();
+}
+
+void PoseFilter::reset()
+{
+	initialized_ = false;
+	last_time_ = 0.;
+	translation_.setZero();
+	orientation_ = tf::Quaternion(0., 0., 0., 1.);
+	variance_translation_ = measurement_variance_translation_;
+	variance_rotation_ = measurement_variance_rotation_;
+}
+
+void PoseFilter::update(const tf::Vector3 &translation, const tf::Quaternion &orientation, const double time)
+{
+	tf::Quaternion measured_orientation = orientation.normalized();
+
+	if ( !initialized_ )
+	{
+		// use value directly on first measurement
+		translation_ = translation;
+		orientation_ = measured_orientation;
+		variance_translation_ = measurement_variance_translation_;
+		variance_rotation_ = measurement_variance_rotation_;
+		last_time_ = time;
+		initialized_ = true;
+		return;
+	}
+
+	// prediction: the pose stays constant, its uncertainty grows with the elapsed time
+	predictVariances(time, variance_translation_, variance_rotation_);
+	last_time_ = std::max(time, last_time_);
+
+	if ( measured_orientation.dot(orientation_) < 0. )  // q and -q are the same rotation, take the one closer to the estimate
+		measured_orientation = -measured_orientation;
+
+	// innovation test: if the measurement contradicts the estimate, the pose has really changed. instead of restarting, the
+	// variances are inflated until the innovation is as likely as an average one (3 degrees of freedom)
+	const double innovation_translation = (translation - translation_).length2();
+	const double innovation_rotation = std::pow(orientation_.angleShortestPath(measured_orientation), 2);
+	if ( innovation_translation/(variance_translation_ + measurement_variance_translation_) > innovation_gate_ )
+		variance_translation_ = innovation_translation/3. - measurement_variance_translation_;
+	if ( innovation_rotation/(variance_rotation_ + measurement_variance_rotation_) > innovation_gate_ )
+		variance_rotation_ = innovation_rotation/3. - measurement_variance_rotation_;
+
+	// correction
+	const double gain_translation = variance_translation_/(variance_translation_ + measurement_variance_translation_);
+	const double gain_rotation = variance_rotation_/(variance_rotation_ + measurement_variance_rotation_);
+	translation_ += gain_translation*(translation - translation_);
+	orientation_ = orientation_.slerp(measured_orientation, gain_rotation).normalized();
+	variance_translation_ *= (1. - gain_translation);
+	variance_rotation_ *= (1. - gain_rotation);
+}
+
+bool PoseFilter::isInitialized() const
+{
+	return initialized_;
+}
+
+void PoseFilter::predictVariances(const double time, double &variance_translation, double &variance_rotation) const
+{
+	const double dt = std::max(time - last_time_, 0.);
+	variance_translation = variance_translation_ + process_variance_translation_*dt;
+	variance_rotation = variance_rotation_ + process_variance_rotation_*dt;
+}
+
+bool PoseFilter::isConverged(const double max_std_translation, const double max_std_rotation, const double time) const
+{
+	return ( initialized_ && getStdTranslation(time) <= max_std_translation && getStdRotation(time) <= max_std_rotation );
+}
+
+tf::Transform PoseFilter::getTransform() const
+{
+	return tf::Transform(orientation_, translation_);
+}
+
+double PoseFilter::getStdTranslation(const double time) const
+{
+	double variance_translation, variance_rotation;
+	predictVariances(time, variance_translation, variance_rotation);
+	return std::sqrt(variance_translation);
+}
+
+double PoseFilter::getStdRotation(const double time) const
+{
+	double variance_translation, variance_rotation;
+	predictVariances(time, variance_translation, variance_rotation);
+	return std::sqrt(variance_rotation);
+}
+
+void PoseFilter::getCovariance(double* covariance, const double time) const
+{
+	double variance_translation, variance_rotation;
+	predictVariances(time, variance_translation, variance_rotation);
+
+	for ( int i=0; i<36; ++i )
+		covariance[i] = 0.;
+
+	for ( int i=0; i<3; ++i )
+	{
+		covariance[7*i] = variance_translation;
+		covariance[7*(i+3)] = variance_rotation;
+	}
+}
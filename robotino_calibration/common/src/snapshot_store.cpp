@@ -0,0 +1,622 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#include <robotino_calibration/snapshot_store.h>
+#include <ros/ros.h>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace snapshot_store
+{
+	static const char MAGIC[8] = { 'R', 'C', 'A', 'L', 'S', 'N', 'A', 'P' };
+	static const char JOURNAL_MAGIC[8] = { 'R', 'C', 'A', 'L', 'J', 'R', 'N', 'L' };
+	static const boost::int32_t VERSION = 2;  // version 2 added the sample variances to tf records
+	static const boost::uint32_t BYTE_ORDER_MARK = 0x01020304;
+	static const size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(VERSION) + sizeof(BYTE_ORDER_MARK);
+
+	// collects the binary representation in memory, frame names are interned while writing
+	class Writer
+	{
+	public:
+
+		void writeInt(const boost::int32_t value)
+		{
+			append(&value, sizeof(value));
+		}
+
+		void writeHeader(const char *magic)
+		{
+			append(magic, sizeof(MAGIC));
+			writeInt(VERSION);
+			append(&BYTE_ORDER_MARK, sizeof(BYTE_ORDER_MARK));
+		}
+
+		void writeTFInfos(const std::vector<TFInfo> &infos)
+		{
+			writeInt(infos.size());
+			for ( int i=0; i<infos.size(); ++i )
+			{
+				writeInt(internFrame(infos[i].parent_));
+				writeInt(internFrame(infos[i].child_));
+
+				const cv::Mat &T = infos[i].transform_;
+				const bool has_transform = ( !T.empty() && T.rows == 4 && T.cols == 4 && T.type() == CV_64FC1 );
+				writeInt(has_transform ? 1 : 0);
+				if ( has_transform )
+				{
+					for ( int r=0; r<4; ++r )
+						append(T.ptr<double>(r), 4*sizeof(double));
+					append(&infos[i].translation_variance_, sizeof(double));
+					append(&infos[i].rotation_variance_, sizeof(double));
+				}
+			}
+		}
+
+		void writeConfiguration(const std::vector<TFSnapshot> &snapshots)  // snapshots of all calibration setups for one robot configuration
+		{
+			writeInt(snapshots.size());
+			for ( int j=0; j<snapshots.size(); ++j )
+			{
+				const TFSnapshot &snapshot = snapshots[j];
+				writeInt(snapshot.valid_ ? 1 : 0);
+				writeInt(snapshot.branch_ends_to_markers_.size());
+				for ( int k=0; k<snapshot.branch_ends_to_markers_.size(); ++k )
+				{
+					writeInt(snapshot.branch_ends_to_markers_[k].corresponding_uncertainty_idx_);
+					writeTFInfos(snapshot.branch_ends_to_markers_[k].branch_to_child_markers_);
+					writeTFInfos(snapshot.branch_ends_to_markers_[k].otherbranch_to_parent_markers_);
+				}
+				writeTFInfos(snapshot.parent_branch_);
+				writeTFInfos(snapshot.child_branch_);
+			}
+		}
+
+		void writeFrameTable(const std::vector<std::string> &frames)
+		{
+			writeInt(frames.size());
+			for ( int i=0; i<frames.size(); ++i )
+			{
+				writeInt(frames[i].size());
+				append(frames[i].data(), frames[i].size());
+			}
+		}
+
+		int internFrame(const FrameId frame)  // file-local id of a frame, only frames that occur in the file are written to its frame table
+		{
+			std::map<FrameId, int>::const_iterator it = frame_ids_.find(frame);
+			if ( it != frame_ids_.end() )
+				return it->second;
+
+			const int id = frames_.size();
+			frame_ids_[frame] = id;
+			frames_.push_back(FrameRegistry::name(frame));
+			return id;
+		}
+
+		void append(const void *data, const size_t size)
+		{
+			const char *bytes = static_cast<const char*>(data);
+			buffer_.insert(buffer_.end(), bytes, bytes+size);
+		}
+
+		std::vector<char> buffer_;
+		std::vector<std::string> frames_;
+		std::map<FrameId, int> frame_ids_;
+	};
+
+	// bounds-checked sequential reader on the mapped file
+	class Reader
+	{
+	public:
+
+		Reader(const char *data, const size_t size) :
+			data_(data), size_(size), position_(0), version_(0)
+		{
+		}
+
+		bool read(void *target, const size_t size)
+		{
+			if ( size > size_-position_ )
+				return false;
+
+			std::memcpy(target, data_+position_, size);
+			position_ += size;
+			return true;
+		}
+
+		bool readInt(boost::int32_t &value)
+		{
+			return read(&value, sizeof(value));
+		}
+
+		bool readCount(int &count)  // non-negative count that can not exceed the remaining data
+		{
+			boost::int32_t value = 0;
+			if ( !readInt(value) || value < 0 || value > size_-position_ )
+				return false;
+			count = value;
+			return true;
+		}
+
+		bool readHeader(const char *magic)
+		{
+			char file_magic[sizeof(MAGIC)];
+			boost::int32_t version = 0;
+			boost::uint32_t byte_order_mark = 0;
+
+			if ( !read(file_magic, sizeof(file_magic)) || std::memcmp(file_magic, magic, sizeof(MAGIC)) != 0 )
+			{
+				ROS_ERROR("snapshot_store::Reader::readHeader - File is no snapshot file.");
+				return false;
+			}
+
+			if ( !readInt(version) || version < 1 || version > VERSION || !read(&byte_order_mark, sizeof(byte_order_mark)) || byte_order_mark != BYTE_ORDER_MARK )
+			{
+				ROS_ERROR("snapshot_store::Reader::readHeader - Unsupported file version %d or byte order.", (int)version);
+				return false;
+			}
+			version_ = version;
+			return true;
+		}
+
+		bool readFrameTable(std::vector<FrameId> &frames)  // maps the file-local frame ids to registry ids
+		{
+			int frame_count = 0;
+			if ( !readCount(frame_count) )
+				return false;
+
+			frames.resize(frame_count);
+			for ( int i=0; i<frame_count; ++i )
+			{
+				int length = 0;
+				if ( !readCount(length) )
+					return false;
+				frames[i] = FrameRegistry::intern(std::string(data_+position_, length));
+				position_ += length;
+			}
+			return true;
+		}
+
+		bool readTFInfos(const std::vector<FrameId> &frames, std::vector<TFInfo> &infos)
+		{
+			int count = 0;
+			if ( !readCount(count) )
+				return false;
+
+			infos.resize(count);
+			for ( int i=0; i<count; ++i )
+			{
+				boost::int32_t parent = 0, child = 0, has_transform = 0;
+				if ( !readInt(parent) || !readInt(child) || !readInt(has_transform) ||
+						parent < 0 || parent >= frames.size() || child < 0 || child >= frames.size() )
+					return false;
+
+				infos[i].parent_ = frames[parent];
+				infos[i].child_ = frames[child];
+				infos[i].transform_.release();
+				infos[i].translation_variance_ = 0.0;
+				infos[i].rotation_variance_ = 0.0;
+				if ( has_transform != 0 )
+				{
+					infos[i].transform_.create(4, 4, CV_64FC1);
+					if ( !read(infos[i].transform_.ptr<double>(0), 16*sizeof(double)) )
+						return false;
+					if ( version_ >= 2 && (!read(&infos[i].translation_variance_, sizeof(double)) || !read(&infos[i].rotation_variance_, sizeof(double))) )
+						return false;
+				}
+			}
+			return true;
+		}
+
+		bool readConfiguration(const std::vector<FrameId> &frames, std::vector<TFSnapshot> &snapshots)
+		{
+			int setup_count = 0;
+			if ( !readCount(setup_count) )
+				return false;
+
+			snapshots.resize(setup_count);
+			for ( int j=0; j<setup_count; ++j )
+			{
+				TFSnapshot &snapshot = snapshots[j];
+				boost::int32_t valid = 0;
+				int betm_count = 0;
+				if ( !readInt(valid) || !readCount(betm_count) )
+					return false;
+
+				snapshot.valid_ = ( valid != 0 );
+				snapshot.branch_ends_to_markers_.resize(betm_count);
+				for ( int k=0; k<betm_count; ++k )
+				{
+					TFBranchEndsToMarkers &betm = snapshot.branch_ends_to_markers_[k];
+					boost::int32_t uncertainty_idx = 0;
+					if ( !readInt(uncertainty_idx) || !readTFInfos(frames, betm.branch_to_child_markers_) ||
+							!readTFInfos(frames, betm.otherbranch_to_parent_markers_) )
+						return false;
+					betm.corresponding_uncertainty_idx_ = uncertainty_idx;
+				}
+
+				if ( !readTFInfos(frames, snapshot.parent_branch_) || !readTFInfos(frames, snapshot.child_branch_) )
+					return false;
+			}
+			return true;
+		}
+
+		const char *data_;
+		size_t size_;
+		size_t position_;
+		boost::int32_t version_;  // format version of the file, older versions are read as well
+	};
+
+	// read-only memory mapping of a whole file
+	class MappedFile
+	{
+	public:
+
+		MappedFile() :
+			data_(0), size_(0)
+		{
+		}
+
+		~MappedFile()
+		{
+			if ( data_ != 0 )
+				munmap(const_cast<char*>(data_), size_);
+		}
+
+		bool open(const std::string &file_path)
+		{
+			const int fd = ::open(file_path.c_str(), O_RDONLY);
+			if ( fd < 0 )
+				return false;
+
+			struct stat file_stat;
+			if ( fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0 )
+			{
+				::close(fd);
+				return false;
+			}
+
+			void *mapped = mmap(0, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);  // mapping stays valid
+			if ( mapped == MAP_FAILED )
+				return false;
+
+			data_ = static_cast<const char*>(mapped);
+			size_ = file_stat.st_size;
+			return true;
+		}
+
+		const char *data_;
+		size_t size_;
+	};
+
+	// FNV-1a, detects records that have been torn by a crash while appending
+	static boost::uint32_t checksum(const char *data, const size_t size)
+	{
+		boost::uint32_t hash = 2166136261u;
+		for ( size_t i=0; i<size; ++i )
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	static bool writeAll(const int fd, const char *data, size_t size)
+	{
+		while ( size > 0 )
+		{
+			const ssize_t written = ::write(fd, data, size);
+			if ( written < 0 )
+			{
+				if ( errno == EINTR )
+					continue;
+				return false;
+			}
+			data += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	bool saveSnapshots(const std::vector< std::vector<TFSnapshot> > &snapshots, const std::string &file_path)
+	{
+		Writer data;
+		for ( int i=0; i<snapshots.size(); ++i )  // go through robot configurations
+			data.writeConfiguration(snapshots[i]);
+
+		Writer header;
+		header.writeHeader(MAGIC);
+		header.writeFrameTable(data.frames_);
+		header.writeInt(snapshots.size());
+
+		std::ofstream file_output(file_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if ( !file_output.is_open() )
+		{
+			ROS_WARN("snapshot_store::saveSnapshots - Failed to open %s, can't save snapshot data!", file_path.c_str());
+			return false;
+		}
+
+		file_output.write(&header.buffer_[0], header.buffer_.size());
+		if ( !data.buffer_.empty() )
+			file_output.write(&data.buffer_[0], data.buffer_.size());
+		file_output.close();
+
+		if ( file_output.fail() )
+		{
+			ROS_WARN("snapshot_store::saveSnapshots - Failed to write %s.", file_path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool loadSnapshots(std::vector< std::vector<TFSnapshot> > &snapshots, const std::string &file_path)
+	{
+		MappedFile file;
+		if ( !file.open(file_path) )
+		{
+			ROS_WARN("snapshot_store::loadSnapshots - Failed to open %s, can't load snapshot data!", file_path.c_str());
+			return false;
+		}
+
+		Reader reader(file.data_, file.size_);
+		std::vector<FrameId> frames;
+		int config_count = 0;
+		if ( !reader.readHeader(MAGIC) || !reader.readFrameTable(frames) || !reader.readCount(config_count) )
+		{
+			ROS_ERROR("snapshot_store::loadSnapshots - %s is corrupted.", file_path.c_str());
+			return false;
+		}
+
+		snapshots.reserve(snapshots.size()+config_count);
+		for ( int i=0; i<config_count; ++i )
+		{
+			std::vector<TFSnapshot> snaps;
+			if ( !reader.readConfiguration(frames, snaps) )
+			{
+				ROS_ERROR("snapshot_store::loadSnapshots - %s is corrupted.", file_path.c_str());
+				return false;
+			}
+			snapshots.push_back(snaps);
+		}
+
+		return true;
+	}
+
+	// journal record: payload size, payload checksum, payload = [configuration index, frame table, configuration]
+	// every record carries its own frame table, so records can be appended without rewriting anything written before
+	static bool readJournalRecord(Reader &reader, int &configuration_idx, std::vector<TFSnapshot> &snapshots)
+	{
+		boost::uint32_t stored_checksum = 0;
+		int payload_size = 0;
+		if ( !reader.readCount(payload_size) || !reader.read(&stored_checksum, sizeof(stored_checksum)) ||
+				payload_size > reader.size_-reader.position_ || checksum(reader.data_+reader.position_, payload_size) != stored_checksum )
+			return false;
+
+		Reader payload(reader.data_+reader.position_, payload_size);
+		reader.position_ += payload_size;
+
+		boost::int32_t idx = 0;
+		std::vector<FrameId> frames;
+		if ( !payload.readInt(idx) || !payload.readFrameTable(frames) || !payload.readConfiguration(frames, snapshots) )
+			return false;
+
+		configuration_idx = idx;
+		return true;
+	}
+
+	// returns the size of the valid part of a journal (header and all complete records), 0 if the file is no journal
+	static size_t scanJournal(const std::string &file_path, std::vector<int> *configuration_indices, std::vector< std::vector<TFSnapshot> > *snapshots,
+								boost::int32_t *version = 0)
+	{
+		MappedFile file;
+		if ( !file.open(file_path) )
+			return 0;
+
+		Reader reader(file.data_, file.size_);
+		if ( !reader.readHeader(JOURNAL_MAGIC) )
+			return 0;
+		if ( version != 0 )
+			*version = reader.version_;
+
+		size_t valid_size = reader.position_;
+		while ( reader.position_ < reader.size_ )
+		{
+			int configuration_idx = -1;
+			std::vector<TFSnapshot> snaps;
+			if ( !readJournalRecord(reader, configuration_idx, snaps) )
+			{
+				ROS_WARN("snapshot_store::scanJournal - Incomplete record at the end of %s (interrupted while writing), ignoring it.", file_path.c_str());
+				break;
+			}
+
+			valid_size = reader.position_;
+			if ( configuration_indices != 0 )
+				configuration_indices->push_back(configuration_idx);
+			if ( snapshots != 0 )
+				snapshots->push_back(snaps);
+		}
+
+		return valid_size;
+	}
+
+	bool loadJournal(const std::string &file_path, std::vector<int> &configuration_indices, std::vector< std::vector<TFSnapshot> > &snapshots)
+	{
+		configuration_indices.clear();
+		snapshots.clear();
+		return ( scanJournal(file_path, &configuration_indices, &snapshots) > 0 );
+	}
+
+	SnapshotJournal::SnapshotJournal() :
+		fd_(-1)
+	{
+	}
+
+	SnapshotJournal::~SnapshotJournal()
+	{
+		close();
+	}
+
+	bool SnapshotJournal::open(const std::string &file_path, const bool resume)
+	{
+		close();
+
+		// a new acquisition does not discard the journal of the previous one, e.g. if resume_acquisition has been forgotten after a crash
+		if ( !resume && boost::filesystem::exists(file_path) )
+		{
+			const std::string backup_path = file_path + ".bak";
+			boost::system::error_code error;
+			boost::filesystem::rename(file_path, backup_path, error);
+			if ( error )
+				ROS_WARN("SnapshotJournal::open - Failed to move existing journal %s to %s, it will be overwritten: %s", file_path.c_str(), backup_path.c_str(), error.message().c_str());
+			else
+				ROS_WARN("SnapshotJournal::open - Moved existing journal %s to %s.", file_path.c_str(), backup_path.c_str());
+		}
+
+		// keep complete records of an existing journal and cut off a record torn by a crash
+		std::vector<int> configuration_indices;
+		std::vector< std::vector<TFSnapshot> > snapshots;
+		boost::int32_t version = VERSION;
+		const size_t valid_size = ( resume ? scanJournal(file_path, &configuration_indices, &snapshots, &version) : 0 );
+		const bool upgrade = ( valid_size > 0 && version != VERSION );  // records of an older format are rewritten, appending to them would mix formats
+		const bool new_file = ( valid_size == 0 || upgrade );
+
+		fd_ = ::open(file_path.c_str(), O_WRONLY | O_CREAT | (new_file ? O_TRUNC : 0), 0644);
+		if ( fd_ < 0 )
+		{
+			ROS_WARN("SnapshotJournal::open - Failed to open %s: %s", file_path.c_str(), std::strerror(errno));
+			return false;
+		}
+
+		if ( new_file )
+		{
+			Writer header;
+			header.writeHeader(JOURNAL_MAGIC);
+			if ( !writeAll(fd_, &header.buffer_[0], header.buffer_.size()) || fsync(fd_) != 0 )
+			{
+				ROS_WARN("SnapshotJournal::open - Failed to write %s: %s", file_path.c_str(), std::strerror(errno));
+				close();
+				return false;
+			}
+
+			for ( int i=0; upgrade && i<configuration_indices.size(); ++i )
+			{
+				if ( !append(configuration_indices[i], snapshots[i]) )
+				{
+					close();
+					return false;
+				}
+			}
+
+			// make the new directory entry durable as well
+			const std::string directory = boost::filesystem::path(file_path).parent_path().string();
+			const int dir_fd = ::open((directory.empty() ? "." : directory.c_str()), O_RDONLY);
+			if ( dir_fd >= 0 )
+			{
+				fsync(dir_fd);
+				::close(dir_fd);
+			}
+		}
+		else if ( ftruncate(fd_, valid_size) != 0 || lseek(fd_, valid_size, SEEK_SET) < 0 )
+		{
+			ROS_WARN("SnapshotJournal::open - Failed to prepare %s for appending: %s", file_path.c_str(), std::strerror(errno));
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool SnapshotJournal::append(const int configuration_idx, const std::vector<TFSnapshot> &snapshots)
+	{
+		if ( fd_ < 0 )
+			return false;
+
+		Writer data;
+		data.writeConfiguration(snapshots);
+
+		Writer payload;
+		payload.writeInt(configuration_idx);
+		payload.writeFrameTable(data.frames_);
+		payload.append(&data.buffer_[0], data.buffer_.size());
+
+		Writer record;
+		record.writeInt(payload.buffer_.size());
+		const boost::uint32_t payload_checksum = checksum(&payload.buffer_[0], payload.buffer_.size());
+		record.append(&payload_checksum, sizeof(payload_checksum));
+		record.append(&payload.buffer_[0], payload.buffer_.size());
+
+		if ( !writeAll(fd_, &record.buffer_[0], record.buffer_.size()) || fdatasync(fd_) != 0 )
+		{
+			ROS_WARN("SnapshotJournal::append - Failed to write configuration %d: %s", configuration_idx, std::strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+	void SnapshotJournal::close()
+	{
+		if ( fd_ >= 0 )
+		{
+			::close(fd_);
+			fd_ = -1;
+		}
+	}
+}
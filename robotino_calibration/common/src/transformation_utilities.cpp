@@ -54,8 +54,12 @@
 
 #include <tf/exceptions.h>
 #include <string>
+#include <algorithm>
 #include <ros/ros.h>
 #include <tf/LinearMath/Matrix3x3.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 
 namespace transform_utilities
@@ -138,6 +142,21 @@ namespace transform_utilities
 	}*/
 
 	// computes the transform from source_frame to target_frame (i.e. transform arrow is pointing from source_frame to target_frame)
+	static cv::Mat transformToMat(const tf::Transform& Ts)
+	{
+		const tf::Matrix3x3& rot = Ts.getBasis();
+		const tf::Vector3& trans = Ts.getOrigin();
+		cv::Mat rotcv(3,3,CV_64FC1);
+		cv::Mat transcv(3,1,CV_64FC1);
+		for (int v=0; v<3; ++v)
+			for (int u=0; u<3; ++u)
+				rotcv.at<double>(v,u) = rot[v].m_floats[u];
+		for (int v=0; v<3; ++v)
+			transcv.at<double>(v) = trans.m_floats[v];
+
+		return makeTransform(rotcv, transcv);
+	}
+
 	bool getTransform(const tf::TransformListener& transform_listener, const std::string& target_frame, const std::string& source_frame, cv::Mat& T, const double timeout, const bool report_error)
 	{
 		try
@@ -154,20 +173,10 @@ namespace transform_utilities
 					throw tf::TransformException("transform_utilities::getTransform - Transform from "+target_frame+" to "+source_frame+" timed out.");
 			}
 
-			const tf::Matrix3x3& rot = Ts.getBasis();
-			const tf::Vector3& trans = Ts.getOrigin();
-			cv::Mat rotcv(3,3,CV_64FC1);
-			cv::Mat transcv(3,1,CV_64FC1);
-			for (int v=0; v<3; ++v)
-				for (int u=0; u<3; ++u)
-					rotcv.at<double>(v,u) = rot[v].m_floats[u];
-			for (int v=0; v<3; ++v)
-				transcv.at<double>(v) = trans.m_floats[v];
-
 			if ( !T.empty() )  // release memory when T is not empty
 				T.release();
 
-			T = makeTransform(rotcv, transcv);
+			T = transformToMat(Ts);
 		}
 		catch (tf::TransformException& ex)
 		{
@@ -180,38 +189,634 @@ namespace transform_utilities
 		return true;
 	}
 
+	bool getTransformsAtCommonTime(const tf::TransformListener& transform_listener, const std::vector< std::pair<std::string, std::string> >& frames,
+			const std::vector<bool>& required, const double timeout, const double max_wait, std::vector<cv::Mat>& transforms, ros::Time& stamp)
+	{
+		const int count = frames.size();
+		transforms.assign(count, cv::Mat());
+		std::vector<ros::Time> latest(count);
+		std::vector<bool> available(count, false);
+		std::string error;
+
+		// latest time each transform can be looked up at, wait for missing required ones
+		const double start_time = ros::Time::now().toSec();
+		int missing_required = -1;
+		while ( true )
+		{
+			missing_required = -1;
+			for (int i=0; i<count; ++i)
+			{
+				if ( available[i] )
+					continue;
+
+				if ( transform_listener.getLatestCommonTime(frames[i].first, frames[i].second, latest[i], &error) == tf::NO_ERROR )
+					available[i] = true;
+				else if ( required[i] && missing_required < 0 )
+					missing_required = i;
+			}
+
+			if ( missing_required < 0 || ros::Time::now().toSec() - start_time > max_wait || !ros::ok() )
+				break;
+
+			ros::Duration(0.01).sleep();
+		}
+
+		if ( missing_required >= 0 )
+		{
+			ROS_WARN("transform_utilities::getTransformsAtCommonTime - Transform from %s to %s is not available: %s", frames[missing_required].first.c_str(), frames[missing_required].second.c_str(), error.c_str());
+			return false;
+		}
+
+		// common stamp = oldest of the latest times of all transforms that are up to date, a zero time means static data that is valid at any time
+		const double current_time = ros::Time::now().toSec();
+		bool stamp_set = false;
+		stamp = ros::Time(0);
+		for (int i=0; i<count; ++i)
+		{
+			if ( !available[i] || latest[i].isZero() )
+				continue;
+
+			if ( timeout > 0.0 && current_time - latest[i].toSec() > timeout )
+			{
+				available[i] = false;
+				if ( required[i] )
+				{
+					ROS_WARN("transform_utilities::getTransformsAtCommonTime - Transform from %s to %s timed out.", frames[i].first.c_str(), frames[i].second.c_str());
+					return false;
+				}
+				continue;
+			}
+
+			if ( !stamp_set || latest[i] < stamp )
+			{
+				stamp = latest[i];
+				stamp_set = true;
+			}
+		}
+
+		// one pass over the tf buffer at the common stamp
+		for (int i=0; i<count; ++i)
+		{
+			if ( !available[i] )
+				continue;
+
+			try
+			{
+				tf::StampedTransform Ts;
+				transform_listener.lookupTransform(frames[i].first, frames[i].second, stamp, Ts);
+				transforms[i] = transformToMat(Ts);
+			}
+			catch (tf::TransformException& ex)
+			{
+				if ( required[i] )
+				{
+					ROS_WARN("transform_utilities::getTransformsAtCommonTime - %s", ex.what());
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void matToRigidTransform(const cv::Mat& T, RigidTransform& rigid)
+	{
+		for (int v=0; v<3; ++v)
+			for (int u=0; u<4; ++u)
+				rigid.data_[4*v+u] = T.at<double>(v,u);
+	}
+
+	cv::Mat rigidTransformToMat(const RigidTransform& rigid)
+	{
+		cv::Mat T = cv::Mat::eye(4,4,CV_64FC1);
+		for (int v=0; v<3; ++v)
+			for (int u=0; u<4; ++u)
+				T.at<double>(v,u) = rigid.data_[4*v+u];
+		return T;
+	}
+
+	void setIdentity(RigidTransform& T)
+	{
+		for (int i=0; i<12; ++i)
+			T.data_[i] = 0.;
+		T.data_[0] = T.data_[5] = T.data_[10] = 1.;
+	}
+
+	void composeTransforms(const RigidTransform& A, const RigidTransform& B, RigidTransform& AB)
+	{
+		const double* a = A.data_;
+		const double* b = B.data_;
+		double* c = AB.data_;
+		for (int v=0; v<3; ++v)
+		{
+			const double* row = a + 4*v;
+			c[4*v+0] = row[0]*b[0] + row[1]*b[4] + row[2]*b[8];
+			c[4*v+1] = row[0]*b[1] + row[1]*b[5] + row[2]*b[9];
+			c[4*v+2] = row[0]*b[2] + row[1]*b[6] + row[2]*b[10];
+			c[4*v+3] = row[0]*b[3] + row[1]*b[7] + row[2]*b[11] + row[3];
+		}
+	}
+
+	void invertTransform(const RigidTransform& T, RigidTransform& T_inv)
+	{
+		// inverse of [R|t] is [R^T|-R^T*t]
+		const double* t = T.data_;
+		double* r = T_inv.data_;
+		for (int v=0; v<3; ++v)
+		{
+			r[4*v+0] = t[v];
+			r[4*v+1] = t[4+v];
+			r[4*v+2] = t[8+v];
+			r[4*v+3] = -(t[v]*t[3] + t[4+v]*t[7] + t[8+v]*t[11]);
+		}
+	}
+
+	void twistToRigidTransform(const double* twist, RigidTransform& T)
+	{
+		const double wx = twist[3], wy = twist[4], wz = twist[5];
+		const double theta_sq = wx*wx + wy*wy + wz*wz;
+		const double theta = std::sqrt(theta_sq);
+
+		// R = I + a*K + b*K^2 with K = [w]x
+		double a, b;
+		if ( theta < 1e-8 )
+		{
+			a = 1.0 - theta_sq/6.0;
+			b = 0.5 - theta_sq/24.0;
+		}
+		else
+		{
+			a = std::sin(theta)/theta;
+			b = (1.0 - std::cos(theta))/theta_sq;
+		}
+
+		double* r = T.data_;
+		r[0] = 1.0 - b*(wy*wy + wz*wz);	r[1] = -a*wz + b*wx*wy;			r[2] = a*wy + b*wx*wz;
+		r[4] = a*wz + b*wx*wy;			r[5] = 1.0 - b*(wx*wx + wz*wz);	r[6] = -a*wx + b*wy*wz;
+		r[8] = -a*wy + b*wx*wz;			r[9] = a*wx + b*wy*wz;			r[10] = 1.0 - b*(wx*wx + wy*wy);
+		r[3] = twist[0];
+		r[7] = twist[1];
+		r[11] = twist[2];
+	}
+
+	void transformPoints(const RigidTransform& T, const double* x, const double* y, const double* z, const int count, cv::Point3d* out)
+	{
+		const double* t = T.data_;
+		int i = 0;
+
+#ifdef __AVX2__
+		const __m256d t0 = _mm256_set1_pd(t[0]), t1 = _mm256_set1_pd(t[1]), t2 = _mm256_set1_pd(t[2]), t3 = _mm256_set1_pd(t[3]);
+		const __m256d t4 = _mm256_set1_pd(t[4]), t5 = _mm256_set1_pd(t[5]), t6 = _mm256_set1_pd(t[6]), t7 = _mm256_set1_pd(t[7]);
+		const __m256d t8 = _mm256_set1_pd(t[8]), t9 = _mm256_set1_pd(t[9]), t10 = _mm256_set1_pd(t[10]), t11 = _mm256_set1_pd(t[11]);
+		double qx[4], qy[4], qz[4];
+
+		for ( ; i+4<=count; i+=4 )
+		{
+			const __m256d px = _mm256_loadu_pd(x+i);
+			const __m256d py = _mm256_loadu_pd(y+i);
+			const __m256d pz = _mm256_loadu_pd(z+i);
+
+			_mm256_storeu_pd(qx, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t0, px), _mm256_mul_pd(t1, py)), _mm256_add_pd(_mm256_mul_pd(t2, pz), t3)));
+			_mm256_storeu_pd(qy, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t4, px), _mm256_mul_pd(t5, py)), _mm256_add_pd(_mm256_mul_pd(t6, pz), t7)));
+			_mm256_storeu_pd(qz, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t8, px), _mm256_mul_pd(t9, py)), _mm256_add_pd(_mm256_mul_pd(t10, pz), t11)));
+
+			// interleave to x,y,z triples
+			for ( int k=0; k<4; ++k )
+			{
+				out[i+k].x = qx[k];
+				out[i+k].y = qy[k];
+				out[i+k].z = qz[k];
+			}
+		}
+#endif
+
+		for ( ; i<count; ++i )
+		{
+			// same summation order as the vectorized loop, so both paths give identical results
+			out[i].x = (t[0]*x[i] + t[1]*y[i]) + (t[2]*z[i] + t[3]);
+			out[i].y = (t[4]*x[i] + t[5]*y[i]) + (t[6]*z[i] + t[7]);
+			out[i].z = (t[8]*x[i] + t[9]*y[i]) + (t[10]*z[i] + t[11]);
+		}
+	}
+
+	void transformDifference(const RigidTransform& A, const RigidTransform& B, double& translation_delta, double& rotation_delta)
+	{
+		const double* a = A.data_;
+		const double* b = B.data_;
+
+		const double dx = a[3]-b[3], dy = a[7]-b[7], dz = a[11]-b[11];
+		translation_delta = std::sqrt(dx*dx + dy*dy + dz*dz);
+
+		// trace(A_R^T * B_R) = 1 + 2*cos(angle)
+		double trace = 0.0;
+		for (int i=0; i<3; ++i)
+			trace += a[i]*b[i] + a[4+i]*b[4+i] + a[8+i]*b[8+i];
+		const double cos_angle = std::max(-1.0, std::min(1.0, 0.5*(trace-1.0)));
+		rotation_delta = std::acos(cos_angle);
+	}
+
+	// eigenvector to the largest eigenvalue of a symmetric 4x4 matrix (N is overwritten), computed with the cyclic Jacobi eigenvalue iteration
+	static void largestEigenvector(double N[4][4], double eigenvector[4])
+	{
+		// V collects the eigenvectors column-wise
+		double V[4][4] = { {1,0,0,0}, {0,1,0,0}, {0,0,1,0}, {0,0,0,1} };
+		for (int sweep=0; sweep<50; ++sweep)
+		{
+			double off_diagonal = 0.0, diagonal = 0.0;
+			for (int p=0; p<4; ++p)
+			{
+				diagonal += N[p][p]*N[p][p];
+				for (int q=p+1; q<4; ++q)
+					off_diagonal += N[p][q]*N[p][q];
+			}
+			if ( off_diagonal <= 1e-30*diagonal || off_diagonal == 0.0 )
+				break;
+
+			for (int p=0; p<3; ++p)
+			{
+				for (int q=p+1; q<4; ++q)
+				{
+					if ( N[p][q] == 0.0 )
+						continue;
+
+					// rotation angle that annihilates N[p][q]
+					const double theta = 0.5*(N[q][q]-N[p][p])/N[p][q];
+					const double t = (theta >= 0.0 ? 1.0 : -1.0)/(std::fabs(theta) + std::sqrt(theta*theta + 1.0));
+					const double c = 1.0/std::sqrt(t*t + 1.0);
+					const double sn = t*c;
+
+					for (int k=0; k<4; ++k)  // N = N*J
+					{
+						const double nkp = N[k][p], nkq = N[k][q];
+						N[k][p] = c*nkp - sn*nkq;
+						N[k][q] = sn*nkp + c*nkq;
+					}
+					for (int k=0; k<4; ++k)  // N = J^T*N
+					{
+						const double npk = N[p][k], nqk = N[q][k];
+						N[p][k] = c*npk - sn*nqk;
+						N[q][k] = sn*npk + c*nqk;
+					}
+					for (int k=0; k<4; ++k)  // V = V*J
+					{
+						const double vkp = V[k][p], vkq = V[k][q];
+						V[k][p] = c*vkp - sn*vkq;
+						V[k][q] = sn*vkp + c*vkq;
+					}
+				}
+			}
+		}
+
+		int largest = 0;
+		for (int i=1; i<4; ++i)
+			if ( N[i][i] > N[largest][largest] )
+				largest = i;
+
+		for (int i=0; i<4; ++i)
+			eigenvector[i] = V[i][largest];
+	}
+
+	ExtrinsicAccumulator::ExtrinsicAccumulator()
+	{
+		reset();
+	}
+
+	void ExtrinsicAccumulator::reset()
+	{
+		count_ = 0;
+		weight_sum_ = 0.0;
+		for (int i=0; i<3; ++i)
+			sum_source_[i] = sum_target_[i] = 0.0;
+		for (int i=0; i<9; ++i)
+			sum_target_source_[i] = 0.0;
+	}
+
+	void ExtrinsicAccumulator::add(const cv::Point3d& point_source, const cv::Point3d& point_target, const double weight)
+	{
+		const double s[3] = { point_source.x, point_source.y, point_source.z };
+		const double t[3] = { weight*point_target.x, weight*point_target.y, weight*point_target.z };
+
+		++count_;
+		weight_sum_ += weight;
+		for (int i=0; i<3; ++i)
+		{
+			sum_source_[i] += weight*s[i];
+			sum_target_[i] += t[i];
+			for (int j=0; j<3; ++j)
+				sum_target_source_[3*i+j] += t[i]*s[j];
+		}
+	}
+
+	int ExtrinsicAccumulator::getCount() const
+	{
+		return count_;
+	}
+
+	void ExtrinsicAccumulator::getCentroids(cv::Point3d& centroid_source, cv::Point3d& centroid_target) const
+	{
+		const double f = ( weight_sum_ > 0.0 ? 1.0/weight_sum_ : 0.0 );
+		centroid_source = cv::Point3d(f*sum_source_[0], f*sum_source_[1], f*sum_source_[2]);
+		centroid_target = cv::Point3d(f*sum_target_[0], f*sum_target_[1], f*sum_target_[2]);
+	}
+
+	void ExtrinsicAccumulator::getCrossCovariance(double* M) const
+	{
+		// sum w*(t-ct)*(s-cs)^T = sum w*t*s^T - W*ct*cs^T
+		const double f = ( weight_sum_ > 0.0 ? 1.0/weight_sum_ : 0.0 );
+		for (int i=0; i<3; ++i)
+			for (int j=0; j<3; ++j)
+				M[3*i+j] = sum_target_source_[3*i+j] - f*sum_target_[i]*sum_source_[j];
+	}
+
+	bool ExtrinsicAccumulator::computeTransform(RigidTransform& T) const
+	{
+		setIdentity(T);
+		if ( count_ == 0 || weight_sum_ <= 0.0 )
+			return false;
+
+		// Horn, 'Closed-form solution of absolute orientation using unit quaternions', 1987:
+		// the rotation from target to source is the eigenvector of N with the largest eigenvalue
+		double S[9];
+		getCrossCovariance(S);
+		const double Sxx = S[0], Sxy = S[1], Sxz = S[2];
+		const double Syx = S[3], Syy = S[4], Syz = S[5];
+		const double Szx = S[6], Szy = S[7], Szz = S[8];
+
+		double N[4][4] = { { Sxx+Syy+Szz,	Syz-Szy,		Szx-Sxz,		Sxy-Syx },
+						   { Syz-Szy,		Sxx-Syy-Szz,	Sxy+Syx,		Szx+Sxz },
+						   { Szx-Sxz,		Sxy+Syx,		-Sxx+Syy-Szz,	Syz+Szy },
+						   { Sxy-Syx,		Szx+Sxz,		Syz+Szy,		-Sxx-Syy+Szz } };
+
+		double q[4];
+		largestEigenvector(N, q);
+		double w = q[0], x = q[1], y = q[2], z = q[3];
+		const double norm = std::sqrt(w*w + x*x + y*y + z*z);
+		w /= norm; x /= norm; y /= norm; z /= norm;
+
+		double* r = T.data_;
+		r[0] = w*w+x*x-y*y-z*z;	r[1] = 2*(x*y-w*z);		r[2] = 2*(x*z+w*y);
+		r[4] = 2*(x*y+w*z);		r[5] = w*w-x*x+y*y-z*z;	r[6] = 2*(y*z-w*x);
+		r[8] = 2*(x*z-w*y);		r[9] = 2*(y*z+w*x);		r[10] = w*w-x*x-y*y+z*z;
+
+		// translation = centroid_source - R*centroid_target
+		cv::Point3d centroid_source, centroid_target;
+		getCentroids(centroid_source, centroid_target);
+		r[3] = centroid_source.x - (r[0]*centroid_target.x + r[1]*centroid_target.y + r[2]*centroid_target.z);
+		r[7] = centroid_source.y - (r[4]*centroid_target.x + r[5]*centroid_target.y + r[6]*centroid_target.z);
+		r[11] = centroid_source.z - (r[8]*centroid_target.x + r[9]*centroid_target.y + r[10]*centroid_target.z);
+		return true;
+	}
+
 	// computes the rigid transform between two sets of corresponding 3d points measured in different coordinate systems
 	// the resulting 4x4 transformation matrix converts point coordinates from the target system into the source coordinate system
 	cv::Mat computeExtrinsicTransform(const std::vector<cv::Point3d>& points_3d_source, const std::vector<cv::Point3d>& points_3d_target)
 	{
-		// from: http://nghiaho.com/?page_id=671 : ‘A Method for Registration of 3-D Shapes’, by Besl and McKay, 1992.
-		cv::Point3d centroid_source, centroid_target;
-		for (size_t i=0; i<points_3d_source.size(); ++i)
+		ExtrinsicAccumulator accumulator;
+		for (size_t i=0; i<points_3d_source.size() && i<points_3d_target.size(); ++i)
+			accumulator.add(points_3d_source[i], points_3d_target[i]);
+
+		RigidTransform T;
+		accumulator.computeTransform(T);
+		return rigidTransformToMat(T);
+	}
+
+	// unit quaternion (w, x, y, z) of the rotation part of a 4x4 transform, Shepperd's method
+	static void rotationToQuaternion(const cv::Mat& T, double q[4])
+	{
+		const double r00 = T.at<double>(0,0), r01 = T.at<double>(0,1), r02 = T.at<double>(0,2);
+		const double r10 = T.at<double>(1,0), r11 = T.at<double>(1,1), r12 = T.at<double>(1,2);
+		const double r20 = T.at<double>(2,0), r21 = T.at<double>(2,1), r22 = T.at<double>(2,2);
+		const double trace = r00 + r11 + r22;
+
+		if ( trace > 0.0 )
+		{
+			const double s = 2.0*std::sqrt(trace + 1.0);
+			q[0] = 0.25*s;	q[1] = (r21-r12)/s;	q[2] = (r02-r20)/s;	q[3] = (r10-r01)/s;
+		}
+		else if ( r00 > r11 && r00 > r22 )
 		{
-			centroid_source += points_3d_source[i];
-			centroid_target += points_3d_target[i];
+			const double s = 2.0*std::sqrt(1.0 + r00 - r11 - r22);
+			q[0] = (r21-r12)/s;	q[1] = 0.25*s;	q[2] = (r01+r10)/s;	q[3] = (r02+r20)/s;
 		}
-		centroid_source *= 1.0/(double)points_3d_source.size();
-		centroid_target *= 1.0/(double)points_3d_target.size();
+		else if ( r11 > r22 )
+		{
+			const double s = 2.0*std::sqrt(1.0 + r11 - r00 - r22);
+			q[0] = (r02-r20)/s;	q[1] = (r01+r10)/s;	q[2] = 0.25*s;	q[3] = (r12+r21)/s;
+		}
+		else
+		{
+			const double s = 2.0*std::sqrt(1.0 + r22 - r00 - r11);
+			q[0] = (r10-r01)/s;	q[1] = (r02+r20)/s;	q[2] = (r12+r21)/s;	q[3] = 0.25*s;
+		}
+	}
 
-		// covariance matrix
-		cv::Mat M = cv::Mat::zeros(3,3,CV_64FC1);
-		for (size_t i=0; i<points_3d_source.size(); ++i)
-			M += cv::Mat(points_3d_target[i] - centroid_target)*cv::Mat(points_3d_source[i] - centroid_source).t();
+	bool averageTransforms(const std::vector<cv::Mat>& samples, cv::Mat& T, double& translation_variance, double& rotation_variance)
+	{
+		translation_variance = 0.0;
+		rotation_variance = 0.0;
 
-		// SVD on covariance matrix yields rotation
-		cv::Mat w, u, vt;
-		cv::SVD::compute(M, w, u, vt, cv::SVD::FULL_UV);
-		cv::Mat R = vt.t()*u.t();
+		std::vector<const cv::Mat*> valid_samples;
+		for (size_t i=0; i<samples.size(); ++i)
+			if ( !samples[i].empty() )
+				valid_samples.push_back(&samples[i]);
 
-		// correct reflection matrix cases
-		if (cv::determinant(R) < 0)
-			for (int r=0; r<3; ++r)
-				R.at<double>(r,2) *= -1;
+		const int n = valid_samples.size();
+		if ( n == 0 )
+			return false;
+
+		// Markley et al., 'Averaging Quaternions', 2007: the average rotation is the eigenvector to the largest
+		// eigenvalue of sum q*q^T, which does not depend on the sign ambiguity of the quaternions
+		std::vector<double> quaternions(4*n);
+		double M[4][4] = { {0,0,0,0}, {0,0,0,0}, {0,0,0,0}, {0,0,0,0} };
+		for (int i=0; i<n; ++i)
+		{
+			double* q = &quaternions[4*i];
+			rotationToQuaternion(*valid_samples[i], q);
+			for (int r=0; r<4; ++r)
+				for (int c=0; c<4; ++c)
+					M[r][c] += q[r]*q[c];
+		}
 
-		// translation
-		cv::Mat t = -R*cv::Mat(centroid_target) + cv::Mat(centroid_source);
+		double q_mean[4];
+		largestEigenvector(M, q_mean);
+		const double norm = std::sqrt(q_mean[0]*q_mean[0] + q_mean[1]*q_mean[1] + q_mean[2]*q_mean[2] + q_mean[3]*q_mean[3]);
+		const double w = q_mean[0]/norm, x = q_mean[1]/norm, y = q_mean[2]/norm, z = q_mean[3]/norm;
 
-		return makeTransform(R, t);
+		// component-wise median of the translations, insensitive to single detection outliers
+		double translation[3];
+		std::vector<double> values(n);
+		for (int k=0; k<3; ++k)
+		{
+			for (int i=0; i<n; ++i)
+				values[i] = valid_samples[i]->at<double>(k,3);
+			std::sort(values.begin(), values.end());
+			translation[k] = ( n%2 == 1 ? values[n/2] : 0.5*(values[n/2-1] + values[n/2]) );
+		}
+
+		// spread of the samples around the fused transform
+		for (int i=0; i<n; ++i)
+		{
+			for (int k=0; k<3; ++k)
+			{
+				const double d = valid_samples[i]->at<double>(k,3) - translation[k];
+				translation_variance += d*d;
+			}
+
+			const double* q = &quaternions[4*i];
+			const double dot = std::min(1.0, std::fabs(w*q[0] + x*q[1] + y*q[2] + z*q[3]));
+			const double angle = 2.0*std::acos(dot);
+			rotation_variance += angle*angle;
+		}
+		translation_variance /= n;
+		rotation_variance /= n;
+
+		T = cv::Mat::eye(4, 4, CV_64FC1);
+		T.at<double>(0,0) = w*w+x*x-y*y-z*z;	T.at<double>(0,1) = 2*(x*y-w*z);		T.at<double>(0,2) = 2*(x*z+w*y);
+		T.at<double>(1,0) = 2*(x*y+w*z);		T.at<double>(1,1) = w*w-x*x+y*y-z*z;	T.at<double>(1,2) = 2*(y*z-w*x);
+		T.at<double>(2,0) = 2*(x*z-w*y);		T.at<double>(2,1) = 2*(y*z+w*x);		T.at<double>(2,2) = w*w-x*x-y*y+z*z;
+		for (int k=0; k<3; ++k)
+			T.at<double>(k,3) = translation[k];
+		return true;
+	}
+
+	static double pointDistance(const RigidTransform& T, const cv::Point3d& point_source, const cv::Point3d& point_target)
+	{
+		const double* t = T.data_;
+		const double dx = t[0]*point_target.x + t[1]*point_target.y + t[2]*point_target.z + t[3] - point_source.x;
+		const double dy = t[4]*point_target.x + t[5]*point_target.y + t[6]*point_target.z + t[7] - point_source.y;
+		const double dz = t[8]*point_target.x + t[9]*point_target.y + t[10]*point_target.z + t[11] - point_source.z;
+		return std::sqrt(dx*dx + dy*dy + dz*dz);
+	}
+
+	static double groupRMS(const RigidTransform& T, const std::vector<cv::Point3d>& points_3d_source, const std::vector<cv::Point3d>& points_3d_target,
+			const int begin, const int end)
+	{
+		double sum = 0.0;
+		for (int i=begin; i<end; ++i)
+		{
+			const double d = pointDistance(T, points_3d_source[i], points_3d_target[i]);
+			sum += d*d;
+		}
+		return ( end > begin ? std::sqrt(sum/(end-begin)) : 0.0 );
+	}
+
+	bool computeRobustExtrinsicTransform(const std::vector<cv::Point3d>& points_3d_source, const std::vector<cv::Point3d>& points_3d_target,
+			const std::vector<int>& group_begin, const RobustLoss loss, const double inlier_threshold, const int max_hypotheses,
+			RigidTransform& T, std::vector<bool>& group_inliers, const std::vector<double>* weights)
+	{
+		const int num_groups = ( group_begin.size() > 0 ? group_begin.size()-1 : 0 );
+		group_inliers.assign(num_groups, false);
+		setIdentity(T);
+
+		// groups that determine a transform on their own
+		std::vector<int> candidates;
+		for (int g=0; g<num_groups; ++g)
+			if ( group_begin[g+1]-group_begin[g] >= 3 )
+				candidates.push_back(g);
+
+		if ( candidates.empty() || points_3d_source.size() != points_3d_target.size() || group_begin.back() > points_3d_source.size() ||
+				(weights != 0 && weights->size() != points_3d_source.size()) )
+			return false;
+
+		// RANSAC, hypotheses are spread evenly over the candidates so that results are reproducible
+		ExtrinsicAccumulator accumulator;
+		RigidTransform hypothesis;
+		int best_inliers = -1;
+		double best_residual = 0.0;
+		const int num_hypotheses = std::min<int>(candidates.size(), std::max(max_hypotheses, 1));
+		for (int h=0; h<num_hypotheses; ++h)
+		{
+			const int g = candidates[(h*candidates.size())/num_hypotheses];
+			accumulator.reset();
+			for (int i=group_begin[g]; i<group_begin[g+1]; ++i)
+				accumulator.add(points_3d_source[i], points_3d_target[i], (weights != 0 ? (*weights)[i] : 1.0));
+			accumulator.computeTransform(hypothesis);
+
+			int inliers = 0;
+			double residual = 0.0;
+			for (int k=0; k<num_groups; ++k)
+			{
+				const double rms = groupRMS(hypothesis, points_3d_source, points_3d_target, group_begin[k], group_begin[k+1]);
+				if ( group_begin[k+1] > group_begin[k] && rms < inlier_threshold )
+				{
+					++inliers;
+					residual += rms;
+				}
+			}
+
+			if ( inliers > best_inliers || (inliers == best_inliers && residual < best_residual) )
+			{
+				best_inliers = inliers;
+				best_residual = residual;
+				T = hypothesis;
+			}
+		}
+
+		for (int k=0; k<num_groups; ++k)
+			group_inliers[k] = ( group_begin[k+1] > group_begin[k] && groupRMS(T, points_3d_source, points_3d_target, group_begin[k], group_begin[k+1]) < inlier_threshold );
+
+		// iteratively reweighted least squares on the inlier groups, the first iteration is a plain least squares fit
+		RigidTransform previous;
+		for (int iteration=0; iteration<20; ++iteration)
+		{
+			accumulator.reset();
+			for (int k=0; k<num_groups; ++k)
+			{
+				if ( !group_inliers[k] )
+					continue;
+
+				for (int i=group_begin[k]; i<group_begin[k+1]; ++i)
+				{
+					double weight = 1.0;
+					if ( iteration > 0 && loss != LOSS_NONE )
+					{
+						const double r = pointDistance(T, points_3d_source[i], points_3d_target[i]);
+						if ( loss == LOSS_HUBER )
+							weight = ( r <= inlier_threshold ? 1.0 : inlier_threshold/r );
+						else  // LOSS_CAUCHY
+							weight = 1.0/(1.0 + (r*r)/(inlier_threshold*inlier_threshold));
+					}
+					if ( weights != 0 )
+						weight *= (*weights)[i];
+					accumulator.add(points_3d_source[i], points_3d_target[i], weight);
+				}
+			}
+
+			previous = T;
+			if ( !accumulator.computeTransform(T) )
+			{
+				T = previous;
+				break;
+			}
+
+			double translation_delta = 0.0, rotation_delta = 0.0;
+			transformDifference(previous, T, translation_delta, rotation_delta);
+			if ( loss == LOSS_NONE || (translation_delta < 1e-9 && rotation_delta < 1e-9) )
+				break;
+		}
+
+		// final inlier decision with the refined transform
+		bool consensus = false;
+		for (int k=0; k<num_groups; ++k)
+		{
+			group_inliers[k] = ( group_begin[k+1] > group_begin[k] && groupRMS(T, points_3d_source, points_3d_target, group_begin[k], group_begin[k+1]) < inlier_threshold );
+			consensus |= group_inliers[k];
+		}
+
+		// without any inlier group (e.g. in the first sweep, while the other uncertainties of the setup are not calibrated yet) the groups
+		// can not be judged, so the transform falls back to the weighted least squares fit over all groups and no group is dropped
+		if ( !consensus )
+		{
+			accumulator.reset();
+			for (int i=group_begin[0]; i<group_begin.back(); ++i)
+				accumulator.add(points_3d_source[i], points_3d_target[i], (weights != 0 ? (*weights)[i] : 1.0));
+			if ( !accumulator.computeTransform(T) )
+				return false;
+
+			for (int k=0; k<num_groups; ++k)
+				group_inliers[k] = ( group_begin[k+1] > group_begin[k] );
+		}
+
+		return true;
 	}
 }
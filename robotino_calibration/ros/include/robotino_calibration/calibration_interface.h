@@ -72,15 +72,32 @@ public:
 	CalibrationInterface(ros::NodeHandle* nh);
 	virtual ~CalibrationInterface();
 
-	// apply new configuration to robot
+	// apply new configuration to robot. the result must only depend on current_index, not on the configurations moved to before,
+	// as configurations are skipped when an acquisition is resumed and may be visited in any order
 	virtual bool moveRobot(int current_index) = 0;
 
 	// get the amount of robot (movement) configurations that have been created by user
 	virtual int getConfigurationCount() = 0;
 
+	// joint/pose values the robot is moved to in configuration current_index, configurations with similar values are expected to give similar
+	// views onto the markers. returns false if the interface does not provide them
+	virtual bool getConfigurationParameters(int current_index, std::vector<double> &parameters);
+
+	// configuration the robot is actually moved to by moveRobot(current_index). unlike current_index it does not depend on the visiting
+	// order, which may change between runs, so it identifies a configuration in the acquisition journal
+	virtual int getScheduledIndex(int current_index);
+
+	// false if the robot would refuse to move from configuration from_index to to_index, e.g. because a joint would have to move
+	// further than allowed at once
+	virtual bool isTransitionFeasible(int from_index, int to_index);
+
 	// give user the chance to execute some code before tf tree will be snapshotted (e.g. wait for transforms to be ready, wait to mitigate shaking effects in robot's kinematic after moving)
 	virtual void preSnapshot(int current_index) = 0;
 
+	// maximum time [s] the robot and the marker detections need to settle after a movement. snapshots are taken as soon as the tf data
+	// has become steady, but never later than this (plus one second for tf to update)
+	virtual double getMaxSettleTime();
+
 	// get the pattern points (in 3 dimensions) for each marker in local marker's frame. markers can have different patterns, hence one can mix pitags, checkerboards, etc...
 	virtual void getPatternPoints3D(const std::string marker_frame, std::vector<cv::Point3f> &pattern_points_3d) = 0;
 
@@ -0,0 +1,240 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+#ifndef COMPILED_SNAPSHOTS_H_
+#define COMPILED_SNAPSHOTS_H_
+
+
+#include <robotino_calibration/calibration_interface.h>
+#include <robotino_calibration/file_utilities.h>
+#include <robotino_calibration/transformation_utilities.h>
+#include <opencv2/opencv.hpp>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// One edge (parent -> child) of a parent- or child-branch
+struct CompiledEdge
+{
+	FrameId parent_id_;
+	FrameId child_id_;
+	int uncertainty_;  // global index of the uncertainty this edge belongs to, -1 if it is a plain tf transform
+	bool inverted_;  // edge runs in opposite direction of its uncertainty
+};
+
+struct CompiledMarkerPair  // trafos from both branch ends to one parent/child marker pair of an uncertainty
+{
+	transform_utilities::RigidTransform otherbranch_to_parent_marker_;
+	transform_utilities::RigidTransform branch_to_child_marker_;
+	int parent_pattern_;  // index into pattern table
+	int child_pattern_;
+	double weight_;  // inverse of the expected point variance of the pair, derived from the variances of the averaged tf samples
+};
+
+struct CompiledPattern  // pattern points of a marker in marker frame, stored as structure of arrays for the batched transform kernel
+{
+	std::vector<double> x_;
+	std::vector<double> y_;
+	std::vector<double> z_;
+	double mean_squared_radius_;  // mean squared distance of the points to the marker origin, scales rotational noise to point noise
+};
+
+struct CompiledTreeNode  // frame of the kinematic tree of a setup
+{
+	FrameId frame_id_;
+	int parent_;  // parent node, -1 for the root
+	int depth_;  // number of edges between root and node
+	int branch_;  // branch the edge from the parent node belongs to (0: parent-branch, 1: child-branch), -1 for the root
+	int edge_;  // index of the edge from the parent node within its branch
+	int uncertainty_;  // global index of the uncertainty on the edge from the parent node, -1 if it is a plain tf transform
+};
+
+struct CompiledKinematicTree  // parent- and child-branch of a setup merged into one tree rooted at the origin
+{
+	std::vector<CompiledTreeNode> nodes_;  // node 0 is the origin, parents always precede their children
+	std::vector<int> branch_nodes_[2];  // tree node of each parent-/child-branch frame, same order as the branch frames
+	std::vector<int> uncertain_nodes_;  // nodes whose edge from the parent node is an uncertainty
+	std::map<FrameId, int> node_ids_;  // frame -> node
+};
+
+struct CompiledSnapshot  // snapshot of one calibration setup for one robot configuration
+{
+	std::vector<transform_utilities::RigidTransform> parent_branch_;  // one trafo per edge, same order as CompiledSetup::parent_edges_
+	std::vector<transform_utilities::RigidTransform> child_branch_;
+	std::vector<transform_utilities::RigidTransform> prefixes_;  // root-to-node trafo of each tree node, calibrated uncertainties use their current estimate
+	std::vector< std::vector<CompiledMarkerPair> > markers_;  // one list per uncertainty of the setup
+	bool valid_;
+};
+
+struct CompiledCacheState  // tracks which uncertainty estimates cached data has been computed with
+{
+	std::vector<int> dependencies_;  // global indices of the uncertainties lying on the chains the cached data is computed from
+	std::vector<unsigned int> versions_;  // version of each dependency at the time the data has been computed
+	bool valid_;
+};
+
+struct CompiledPointCache : public CompiledCacheState  // marker points of one uncertainty over all snapshots of its setup, expressed in uncertainty parent or child frame
+{
+	std::vector<cv::Point3d> points_;
+	std::vector<double> weights_;  // weight of each point correspondence, only filled in the parent point cache
+	std::vector<int> snapshot_begin_;  // index of the first point of each snapshot in points_, the last entry is points_.size()
+};
+
+struct CompiledSetup
+{
+	std::vector<CompiledEdge> parent_edges_;  // edges from origin up to last parent-branch frame
+	std::vector<CompiledEdge> child_edges_;  // edges from origin up to last child-branch frame
+	std::vector<int> uncertainties_;  // global uncertainty indices, same order as CalibrationSetup::uncertainties_list_
+	CompiledKinematicTree tree_;
+	CompiledCacheState prefix_state_;  // validity of CompiledSnapshot::prefixes_ of all snapshots
+	std::vector<CompiledSnapshot> snapshots_;  // one per robot configuration
+	std::vector<CompiledPointCache> parent_points_;  // one per uncertainty, parent marker points in uncertainty parent frame
+	std::vector<CompiledPointCache> child_points_;  // one per uncertainty, child marker points in uncertainty child frame
+};
+
+struct CompiledUncertainty
+{
+	FrameId parent_id_;
+	FrameId child_id_;
+	int setup_idx_;
+	int uncertainty_idx_;  // index within uncertainties_list_ of its setup
+	bool on_parent_branch_;
+	int parent_node_;  // index of uncertainty parent frame in branch chain (0 = origin)
+	int child_node_;  // index of uncertainty child frame in branch chain
+	transform_utilities::RigidTransform current_trafo_;
+	bool calibrated_;
+	unsigned int version_;  // incremented whenever current_trafo_ changes, invalidates point caches depending on this uncertainty
+};
+
+
+// Flattened representation of calibration setups and tf snapshots used by the optimization.
+// Frames are referred to by their FrameRegistry ids and all transforms are stored as fixed-size arrays once,
+// so that the solver does neither compare strings nor allocate memory while iterating.
+class CompiledSnapshots
+{
+public:
+
+	CompiledSnapshots();
+	~CompiledSnapshots();
+
+	// builds the flattened representation, pattern points of all markers are fetched from the calibration interface once
+	bool compile(const std::vector<CalibrationSetup> &setups, const std::vector< std::vector<TFSnapshot> > &snapshots, CalibrationInterface *calibration_interface);
+
+	// returns corresponding marker points in uncertainty parent and uncertainty child frame over all snapshots of the uncertainty's setup
+	// the points are cached per uncertainty and only recomputed if an uncertainty on the respective chains has been updated since the last call
+	// the returned pointers stay valid until the next call to compile(), snapshot_begin holds the first parent point index of each snapshot
+	// and weights the weight of each correspondence (inverse point variance of its marker pair)
+	bool collectPoints(const int setup_idx, const int uncertainty_idx, const std::vector<cv::Point3d> *&points_parent, const std::vector<cv::Point3d> *&points_child,
+						const std::vector<int> *&snapshot_begin, const std::vector<double> *&weights);
+
+	// assigns a new estimate to an uncertainty and marks it calibrated, chains passing the uncertainty will use this estimate from now on
+	void updateUncertainty(const int setup_idx, const int uncertainty_idx, const transform_utilities::RigidTransform &trafo);
+
+	// evaluates the closed-loop point residuals (child-branch chain vs. parent-branch chain, expressed in origin frame) over all snapshots of a setup
+	// and returns their squared sum, each point weighted by the weight of its marker pair (normalized to a mean of one). if JtJ and Jtr are given, the Gauss-Newton normal equations are accumulated as well, with all uncertainties
+	// of the setup as variables (6 parameters each: translation and rotation of a perturbation multiplied from the right)
+	double evaluateSetup(const int setup_idx, cv::Mat *JtJ, cv::Mat *Jtr, int &residual_count) const;
+
+	// right-multiplies each uncertainty of a setup with the rigid motion given by its 6 increment parameters and marks it calibrated
+	void applyIncrement(const int setup_idx, const cv::Mat &delta);
+
+	void getUncertaintyTrafos(const int setup_idx, std::vector<transform_utilities::RigidTransform> &trafos) const;
+	void setUncertaintyTrafos(const int setup_idx, const std::vector<transform_utilities::RigidTransform> &trafos);
+
+	// writes current estimates and calibrated flags back to the calibration setups
+	void exportUncertainties(std::vector<CalibrationSetup> &setups) const;
+
+	// partitions the setups into groups that do not share any uncertainty: two setups depend on each other if an uncertainty of one
+	// lies on a branch of the other. setups of different groups can be optimized concurrently, each group is sorted ascending
+	void getIndependentSetupGroups(std::vector< std::vector<int> > &groups) const;
+
+
+protected:
+
+	int internPattern(const FrameId marker_frame, CalibrationInterface *calibration_interface);
+
+	bool compileBranch(const std::vector<FrameId> &frames, std::vector<CompiledEdge> &edges);
+	bool compileBranchSnapshot(const std::vector<CompiledEdge> &edges, const std::vector<TFInfo> &branch, std::vector<transform_utilities::RigidTransform> &trafos) const;
+	int findUncertainty(const FrameId parent_id, const FrameId child_id, bool &inverted) const;
+
+	// merges parent- and child-branch of a setup into its kinematic tree, frames shared by both branches become one node
+	void buildKinematicTree(const CalibrationSetup &calibration_setup, CompiledSetup &setup) const;
+
+	// recomputes the root-to-node prefix trafos of all snapshots of a setup if an uncertainty of its tree has been updated since
+	void updatePrefixes(CompiledSetup &setup) const;
+
+	// trafo from node from to node to of a kinematic tree, composed out of the prefixes of one snapshot in constant time
+	void chainTransform(const CompiledSnapshot &snapshot, const int from, const int to, transform_utilities::RigidTransform &result) const;
+
+	// registers the uncertainties on edges [begin, end) of a branch as dependencies of a cache
+	void addCacheDependencies(const std::vector<CompiledEdge> &edges, const int begin, const int end, CompiledCacheState &cache) const;
+	bool isCacheCurrent(const CompiledCacheState &cache) const;
+	void markCacheCurrent(CompiledCacheState &cache) const;
+
+	// returns the trafo of an edge, the current estimate is used instead of the snapshotted one if the edge is a calibrated uncertainty
+	const transform_utilities::RigidTransform& edgeTransform(const CompiledEdge &edge, const transform_utilities::RigidTransform &snapshotted, transform_utilities::RigidTransform &buffer) const;
+
+	// resolves the trafo of every edge of a branch for one snapshot, uncertainties of the optimized setup always use their current estimate
+	void resolveBranch(const std::vector<CompiledEdge> &edges, const std::vector<transform_utilities::RigidTransform> &snapshotted, const int optimized_setup_idx, std::vector<transform_utilities::RigidTransform> &trafos) const;
+
+	void transformPattern(const transform_utilities::RigidTransform &T, const int pattern_idx, std::vector<cv::Point3d> &points) const;
+
+
+	std::map<FrameId, int> pattern_ids_;  // marker frame -> pattern index
+	std::vector<CompiledPattern> patterns_;
+	std::vector<CompiledSetup> setups_;
+	std::vector<CompiledUncertainty> uncertainties_;
+	std::map<std::pair<FrameId, FrameId>, int> uncertainty_ids_;  // (parent, child) -> global uncertainty index
+};
+
+
+#endif /* COMPILED_SNAPSHOTS_H_ */
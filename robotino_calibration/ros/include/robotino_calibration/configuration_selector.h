@@ -0,0 +1,133 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+#ifndef CONFIGURATION_SELECTOR_H_
+#define CONFIGURATION_SELECTOR_H_
+
+
+#include <robotino_calibration/calibration_interface.h>
+#include <robotino_calibration/file_utilities.h>
+#include <robotino_calibration/transformation_utilities.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+
+// Active selection of robot configurations: after each snapshot the covariance of every uncertainty is estimated from the information
+// matrix of its point registration, the next configuration is the one that is expected to reduce these covariances most.
+// The information a configuration will contribute is interpolated from the visited configurations around it in parameter space (inverse
+// distance weighting), so regions without marker detections are avoided. The expected gain is discounted for configurations close to
+// visited ones, hence new viewpoints are preferred over repeating the most informative one.
+class ConfigurationSelector
+{
+public:
+
+	ConfigurationSelector();
+	~ConfigurationSelector();
+
+	// parameters: joint/pose values of each configuration, empty if not provided by the calibration interface (the configuration index is used instead)
+	// the first initial_configurations configurations are spread over the parameter space, precisions are standard deviations [m] and [rad]
+	void initialize(const std::vector< std::vector<double> > &parameters, const int initial_configurations, const double translation_precision, const double rotation_precision);
+
+	void markVisited(const int config_index);
+
+	// adds the information the snapshot of configuration config_index contributes to each uncertainty and updates their covariances,
+	// only the new snapshot is evaluated
+	bool update(const std::vector<CalibrationSetup> &setups, const std::vector<TFSnapshot> &snapshot, const int config_index, CalibrationInterface *calibration_interface);
+
+	// true once all uncertainties are known better than the target precisions
+	bool isPrecisionReached() const;
+
+	// returns the unvisited configuration with the largest expected information gain, -1 if all configurations have been visited.
+	// configurations the robot would refuse to move to from current_config are only chosen if no other one is left, current_config
+	// is -1 if the robot's configuration is unknown
+	int selectNext(const int current_config, CalibrationInterface *calibration_interface) const;
+
+
+protected:
+
+	// sums of the point registration of one uncertainty over all snapshots, they give its residuals without keeping the points
+	struct RegistrationSums
+	{
+		transform_utilities::ExtrinsicAccumulator accumulator_;
+		double weight_sum_;
+		double squared_norm_sum_parent_;  // sum w*|p_parent|^2
+		double squared_norm_sum_child_;  // sum w*|p_child|^2
+
+		RegistrationSums() : weight_sum_(0.0), squared_norm_sum_parent_(0.0), squared_norm_sum_child_(0.0) {}
+	};
+
+	double getDistance(const int config_a, const int config_b) const;  // normalized distance of two configurations in parameter space
+
+	double getVarianceFactor(const RegistrationSums &sums) const;  // a posteriori variance factor of the weights, 1 if there is no redundancy
+
+	int getFarthestConfiguration(const std::vector<bool> &candidates) const;  // candidate farthest away from all visited configurations
+
+	void addPointInformation(const cv::Point3d &point, const double weight, cv::Mat &information) const;
+
+	double getLogDeterminant(const cv::Mat &information) const;
+
+
+	std::vector< std::vector<double> > parameters_;
+	std::vector<double> parameter_scales_;  // inverse range of each parameter over all configurations
+	double configuration_spacing_;  // mean distance of a configuration to its nearest neighbor, scale of the discount of nearby configurations
+	std::vector<bool> visited_;
+	int visited_count_;
+	int initial_configurations_;
+	double translation_precision_;
+	double rotation_precision_;
+	// information matrices are kept with the weights of the points only, the variance factor scales the covariances but cancels in the gain
+	std::vector< std::vector<cv::Mat> > information_;  // per configuration and uncertainty: 6x6 information matrix of its snapshot, empty if it has no snapshot
+	std::vector<cv::Mat> total_information_;  // per uncertainty, sum over all snapshots
+	std::vector<RegistrationSums> registrations_;  // per uncertainty
+	std::vector<bool> converged_;  // per uncertainty: target precision reached
+};
+
+
+#endif /* CONFIGURATION_SELECTOR_H_ */
@@ -59,8 +59,11 @@
 #include <robotino_calibration/calibration_interface.h>
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include <map>
+#include <boost/thread/mutex.hpp>
 
 #include <robotino_calibration/file_utilities.h>
+#include <robotino_calibration/compiled_snapshots.h>
 
 
 class RobotCalibration
@@ -75,38 +78,86 @@ public:
 
 protected:
 
+    // captures parent of each tf frame from one dump of the tf tree, repeated until all required frames are present or timeout [s] has passed
+    bool captureFrameGraph(const std::vector<std::string> &required_frames, const double timeout);
+
+    // reads the transform from each required frame's parent to that frame once, see frame_transforms_
+    void captureFrameTransforms(const std::vector<std::string> &required_frames);
+
+    bool getFrameParent(const std::string &frame, std::string &parent) const;  // false if frame is unknown or a root of the captured frame graph
+
+    bool areFramesConnected(const std::string &frame_a, const std::string &frame_b) const;  // whether both frames lie in the same tree of the captured frame graph
+
     bool getOrigin(const std::string last_parent_branch_frame, const std::string last_child_branch_frame, std::string &origin);  // returns mutual frame of parent_marker and child_marker back-chains
 
-    bool isPartOfCalibrationSetup(const std::string parent, const std::string child, const std::string origin, const CalibrationSetup &setup);  // returns whether passed uncertainty is part of passed calibration setup
+    bool isPartOfCalibrationSetup(const FrameId parent, const FrameId child, const FrameId origin, const CalibrationSetup &setup);  // returns whether passed uncertainty is part of passed calibration setup
 
-    void feedCalibrationSetup(CalibrationSetup &setup, const std::string parent, const std::string child,
-    							const std::string parent_marker, const std::string child_marker);  // extend existing calibration setup by new information given
+    void feedCalibrationSetup(CalibrationSetup &setup, const FrameId parent, const FrameId child,
+    							const FrameId parent_marker, const FrameId child_marker);  // extend existing calibration setup by new information given
 
     bool getBackChain(const std::string frame_start, const std::string frame_end, std::vector<std::string> &backchain);
 
-    void getForwardChain(const std::vector<std::string> &backchain, std::vector<std::string> &forwardchain);  // takes backchain and reverses it
+    void getForwardChain(const std::vector<std::string> &backchain, std::vector<FrameId> &forwardchain);  // takes backchain, reverses it and interns its frames
 
     void sortUncertainties(const bool parent_branch, CalibrationSetup &setup, std::vector<CalibrationInfo> &sorted_uncertainties);  // sorts parent- and child-branch uncertainties of passed calibration setup
 
-    void truncateBranch(std::vector<std::string> &branch, std::vector<CalibrationInfo> &branch_uncertainties);
+    void truncateBranch(std::vector<FrameId> &branch, std::vector<CalibrationInfo> &branch_uncertainties);
 
     bool acquireTFData();
 
-    void populateTFSnapshot(const CalibrationSetup &setup, TFSnapshot &snapshot);
+    // frame pairs whose transforms are captured for a robot configuration
+    struct FramePairList
+    {
+    	std::vector< std::pair<std::string, std::string> > frames_;  // (parent, child) names for tf lookups
+    	std::vector<bool> required_;  // branch links are required, marker transforms may be missing
+    	std::map<std::pair<FrameId, FrameId>, int> index_;
+    };
+
+    void getBranchEndFrames(const CalibrationSetup &setup, const int uncertainty_idx, FrameId &last_branch_frame, FrameId &last_otherbranch_frame);
+
+    int addFramePair(const FrameId parent, const FrameId child, const bool required, FramePairList &frame_pairs);
+
+    bool lookupFramePair(const FrameId parent, const FrameId child, const FramePairList &frame_pairs, const std::vector<TFInfo> &fused, TFInfo &info);  // false if not captured
 
-    std::vector<TFInfo>* getBranchEndToMarkers(const int uncertainty_index, const bool parent_markers, TFSnapshot &snapshot);
+    void collectFramePairs(FramePairList &frame_pairs);  // all transforms a snapshot of the calibration setups consists of
 
-    bool buildTransformChain(const std::string start, const std::string end, const std::vector<TFInfo> &branch, cv::Mat &trafo);  // returns the transform between two arbitrary points in a branch
+    // waits until the transforms of frame_pairs have stopped moving for settle_window_ seconds (i.e. the robot's joints and the marker
+    // detections have settled), at most max_wait seconds. returns false on timeout
+    bool waitForSettle(const FramePairList &frame_pairs, const double max_wait);
 
-    bool retrieveTransform(const std::string parent, const std::string child, const std::vector<TFInfo> &branch, cv::Mat &trafo);  // returns the transform between two points in a branch that are neighbours
+    // captures the transforms of all calibration setups at one common time stamp, returns false if any setup's snapshot is invalid
+    // with tf_samples_ > 1 several such samples are taken and fused per transform
+    bool populateTFSnapshots(const FramePairList &frame_pairs, std::vector<TFSnapshot> &snapshots);
+
+    void populateTFSnapshot(const CalibrationSetup &setup, const FramePairList &frame_pairs, const std::vector<TFInfo> &fused, TFSnapshot &snapshot);
+
+    // solves the setup groups handed out by next_optimization_group_ until none is left, runs in one thread of the optimization pool
+    void optimizationWorker();
+
+    bool optimizeSetup(const int current_setup_idx);
 
     bool extrinsicCalibration(const int current_setup_idx, const int current_uncertainty_idx);
 
+    bool jointCalibration(const int current_setup_idx);  // optimizes all uncertainties of a calibration setup together with Levenberg-Marquardt
+
+    // checks whether an optimization sweep has changed the uncertainties of a setup less than the convergence thresholds
+    bool hasConverged(const int current_setup_idx, const std::vector<transform_utilities::RigidTransform> &previous_trafos);
+
+    double computeRMSResidual(const int current_setup_idx);  // RMS marker point residual of a calibration setup with current estimates
+
     // displays the calibration result on the screen and also stores it to a file in the urdf file's format
     void displayAndSaveCalibrationResult();
 
 
     int optimization_iterations_;	// number of iterations for optimization
+    std::string optimization_method_;  // "alternating": re-solve one uncertainty after another, "joint": Levenberg-Marquardt over all uncertainties of a setup
+    double convergence_translation_threshold_;  // [m] optimization stops if no uncertainty translation changes more than this during an iteration
+    double convergence_rotation_threshold_;  // [rad] optimization stops if no uncertainty rotation changes more than this during an iteration
+    double convergence_residual_threshold_;  // [m] ... and the RMS point residual changes less than this
+    transform_utilities::RobustLoss robust_loss_;  // loss used for robust estimation of each uncertainty, robust estimation is off if robust_estimation_ is false
+    bool robust_estimation_;
+    double robust_inlier_threshold_;  // [m] RMS point distance below which a robot configuration counts as inlier, also scale of the robust loss
+    int ransac_hypotheses_;  // maximum number of RANSAC hypotheses per uncertainty
     bool calibrated_;  // calibration has successfully been finished
     bool load_data_from_disk_;
     double transform_discard_timeout_;  // timeout after which a TF transform won't be used for calibration anymore
@@ -115,9 +166,36 @@ protected:
     std::string calibration_storage_path_;  // path to data
     std::string calib_data_folder_;
     std::string calib_data_file_name_;
+    std::string calib_snapshot_file_name_;  // binary snapshot store next to calib_data_file_name_
+    std::string calib_journal_file_name_;  // snapshots are journaled here while they are captured
+    bool resume_acquisition_;  // continue an interrupted acquisition from its journal
+    int tf_samples_;  // number of tf samples that are fused per robot configuration
+    double tf_sample_interval_;  // [s] pause between two tf samples
+    double tf_max_wait_;  // [s] maximum time to wait for the transforms of one tf sample
+    bool settle_detection_;  // snapshot as soon as the tf data has settled instead of waiting the maximum settle time
+    double settle_window_;  // [s] time span the transforms have to be steady
+    double settle_translation_threshold_;  // [m] maximum standard deviation of a steady transform's translation over the window
+    double settle_rotation_threshold_;  // [rad] maximum standard deviation of a steady transform's rotation over the window
+    bool active_sampling_;  // choose the next robot configuration by expected information gain and stop once the target precisions are reached
+    int active_initial_configurations_;  // configurations spread over the configuration space before active selection starts
+    double active_translation_precision_;  // [m] target standard deviation of each uncertainty's translation
+    double active_rotation_precision_;  // [rad] target standard deviation of each uncertainty's rotation
+    double frame_graph_timeout_;  // [s] maximum time to wait for all frames of the uncertainties list to appear in tf
+    std::map<std::string, std::string> frame_parents_;  // frame -> parent frame, root frames map to an empty string
+    std::map<std::string, cv::Mat> frame_transforms_;  // frame -> transform from its parent, captured with the frame graph for the required frames
     CalibrationInterface *calibration_interface_;
     std::vector<CalibrationSetup> calibration_setups_;
     std::vector< std::vector<TFSnapshot> > tf_snapshots_;  // each robot configuration has calibration setup count snapshopts
+    std::vector<int> snapshot_configs_;  // visiting index of the robot configuration of each entry of tf_snapshots_, empty if they have been loaded from disk
+    CompiledSnapshots compiled_snapshots_;  // flattened tf_snapshots_ the optimization runs on
+    int optimization_threads_;  // maximum number of setup groups that are optimized concurrently
+    std::vector< std::vector<int> > optimization_groups_;  // groups of calibration setups that do not share any uncertainty
+    int next_optimization_group_;  // next group to be handed out to a worker thread
+    bool optimization_failed_;
+    boost::mutex optimization_mutex_;  // guards next_optimization_group_ and optimization_failed_
+    std::vector<int> optimization_iteration_counts_;  // number of performed optimization iterations for each calibration setup
+    std::vector< std::vector<double> > residual_histories_;  // RMS point residual after each optimization iteration for each calibration setup
+    std::vector< std::vector<bool> > configuration_inliers_;  // per calibration setup and robot configuration: inlier for all uncertainties in the last iteration (robust estimation only)
 
 
 };
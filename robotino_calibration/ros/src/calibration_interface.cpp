@@ -67,3 +67,24 @@ CalibrationInterface::~CalibrationInterface()
 {
 }
 
+bool CalibrationInterface::getConfigurationParameters(int current_index, std::vector<double> &parameters)
+{
+	parameters.clear();
+	return false;
+}
+
+int CalibrationInterface::getScheduledIndex(int current_index)
+{
+	return current_index;
+}
+
+bool CalibrationInterface::isTransitionFeasible(int from_index, int to_index)
+{
+	return true;
+}
+
+double CalibrationInterface::getMaxSettleTime()
+{
+	return 0.0;
+}
+
@@ -0,0 +1,870 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+
+#include <robotino_calibration/compiled_snapshots.h>
+#include <algorithm>
+#include <ros/ros.h>
+
+
+// lower bound of the point variance of a marker pair [m^2], keeps weights finite if only one tf sample has been taken per configuration
+static const double MIN_POINT_VARIANCE = 1e-6;
+
+CompiledSnapshots::CompiledSnapshots()
+{
+}
+
+CompiledSnapshots::~CompiledSnapshots()
+{
+}
+
+bool CompiledSnapshots::compile(const std::vector<CalibrationSetup> &setups, const std::vector< std::vector<TFSnapshot> > &snapshots, CalibrationInterface *calibration_interface)
+{
+	pattern_ids_.clear();
+	patterns_.clear();
+	setups_.clear();
+	uncertainties_.clear();
+	uncertainty_ids_.clear();
+
+	if ( calibration_interface == 0 )
+	{
+		ROS_ERROR("CompiledSnapshots::compile - Calibration interface has not been created!");
+		return false;
+	}
+
+	// register all uncertainties first, as branches of one setup may contain uncertainties of other setups
+	setups_.resize(setups.size());
+	for ( int i=0; i<setups.size(); ++i )
+	{
+		for ( int j=0; j<setups[i].uncertainties_list_.size(); ++j )
+		{
+			const CalibrationInfo &info = setups[i].uncertainties_list_[j];
+			const std::vector<FrameId> &branch = (info.parent_branch_uncertainty_ ? setups[i].parent_branch_ : setups[i].child_branch_);
+
+			CompiledUncertainty uncertainty;
+			uncertainty.parent_id_ = info.parent_;
+			uncertainty.child_id_ = info.child_;
+			uncertainty.setup_idx_ = i;
+			uncertainty.uncertainty_idx_ = j;
+			uncertainty.on_parent_branch_ = info.parent_branch_uncertainty_;
+			uncertainty.parent_node_ = -1;
+			uncertainty.child_node_ = -1;
+			uncertainty.calibrated_ = info.calibrated_;
+			uncertainty.version_ = 0;
+
+			for ( int k=0; k+1<branch.size(); ++k )
+			{
+				if ( branch[k] == info.parent_ && branch[k+1] == info.child_ )
+				{
+					uncertainty.parent_node_ = k;
+					uncertainty.child_node_ = k+1;
+					break;
+				}
+			}
+
+			if ( uncertainty.parent_node_ < 0 || info.current_trafo_.empty() )
+			{
+				ROS_ERROR("CompiledSnapshots::compile - Uncertainty from %s to %s is not part of its branch or has no initial transform.", FrameRegistry::name(info.parent_).c_str(), FrameRegistry::name(info.child_).c_str());
+				return false;
+			}
+
+			transform_utilities::matToRigidTransform(info.current_trafo_, uncertainty.current_trafo_);
+			uncertainty_ids_[std::make_pair(uncertainty.parent_id_, uncertainty.child_id_)] = uncertainties_.size();
+			setups_[i].uncertainties_.push_back(uncertainties_.size());
+			uncertainties_.push_back(uncertainty);
+		}
+	}
+
+	// compile branch structure and snapshots of each setup
+	for ( int i=0; i<setups.size(); ++i )
+	{
+		CompiledSetup &setup = setups_[i];
+
+		if ( !compileBranch(setups[i].parent_branch_, setup.parent_edges_) || !compileBranch(setups[i].child_branch_, setup.child_edges_) )
+			return false;
+
+		buildKinematicTree(setups[i], setup);
+
+		setup.snapshots_.resize(snapshots.size());
+		for ( int k=0; k<snapshots.size(); ++k )
+		{
+			CompiledSnapshot &compiled = setup.snapshots_[k];
+			compiled.valid_ = false;
+
+			if ( snapshots[k].size() <= i )
+			{
+				ROS_WARN("CompiledSnapshots::compile - Snapshot %d has no entry for calibration setup %d, skipping.", k, i);
+				continue;
+			}
+
+			const TFSnapshot &snapshot = snapshots[k][i];
+			if ( !compileBranchSnapshot(setup.parent_edges_, snapshot.parent_branch_, compiled.parent_branch_) ||
+					!compileBranchSnapshot(setup.child_edges_, snapshot.child_branch_, compiled.child_branch_) )
+			{
+				ROS_ERROR("CompiledSnapshots::compile - Failed to build one or more necessary transforms, skipping snapshot %d.", k);
+				continue;
+			}
+
+			compiled.markers_.resize(setup.uncertainties_.size());
+			for ( int j=0; j<snapshot.branch_ends_to_markers_.size(); ++j )
+			{
+				const TFBranchEndsToMarkers &betm = snapshot.branch_ends_to_markers_[j];
+				const int uncertainty_idx = betm.corresponding_uncertainty_idx_;
+
+				if ( uncertainty_idx < 0 || uncertainty_idx >= compiled.markers_.size() )
+					continue;
+
+				if ( betm.branch_to_child_markers_.size() != betm.otherbranch_to_parent_markers_.size() )
+				{
+					ROS_WARN("CompiledSnapshots::compile - branch_to_child_markers vector and otherbranch_to_parent_markers vector do not have the same size in snapshot %d, skipping.", k);
+					continue;
+				}
+
+				std::vector<CompiledMarkerPair> &markers = compiled.markers_[uncertainty_idx];
+				markers.reserve(betm.branch_to_child_markers_.size());
+				for ( int l=0; l<betm.branch_to_child_markers_.size(); ++l )
+				{
+					const TFInfo &to_parent_marker = betm.otherbranch_to_parent_markers_[l];
+					const TFInfo &to_child_marker = betm.branch_to_child_markers_[l];
+
+					if ( to_parent_marker.transform_.empty() || to_child_marker.transform_.empty() )
+						continue;
+
+					CompiledMarkerPair pair;
+					transform_utilities::matToRigidTransform(to_parent_marker.transform_, pair.otherbranch_to_parent_marker_);
+					transform_utilities::matToRigidTransform(to_child_marker.transform_, pair.branch_to_child_marker_);
+					pair.parent_pattern_ = internPattern(to_parent_marker.child_, calibration_interface);
+					pair.child_pattern_ = internPattern(to_child_marker.child_, calibration_interface);
+
+					// pairs whose markers have been detected unsteadily contribute less
+					const double point_variance = MIN_POINT_VARIANCE +
+							to_parent_marker.translation_variance_ + to_parent_marker.rotation_variance_*patterns_[pair.parent_pattern_].mean_squared_radius_ +
+							to_child_marker.translation_variance_ + to_child_marker.rotation_variance_*patterns_[pair.child_pattern_].mean_squared_radius_;
+					pair.weight_ = 1.0/point_variance;
+					markers.push_back(pair);
+				}
+			}
+
+			compiled.valid_ = true;
+		}
+
+		// prefixes depend on every uncertainty of the tree, point caches only on the ones their chains pass
+		addCacheDependencies(setup.parent_edges_, 0, setup.parent_edges_.size(), setup.prefix_state_);
+		addCacheDependencies(setup.child_edges_, 0, setup.child_edges_.size(), setup.prefix_state_);
+		setup.prefix_state_.valid_ = false;
+
+		setup.parent_points_.resize(setup.uncertainties_.size());
+		setup.child_points_.resize(setup.uncertainties_.size());
+		for ( int j=0; j<setup.uncertainties_.size(); ++j )
+		{
+			const CompiledUncertainty &uncertainty = uncertainties_[setup.uncertainties_[j]];
+			const std::vector<CompiledEdge> &branch_edges = (uncertainty.on_parent_branch_ ? setup.parent_edges_ : setup.child_edges_);
+			const std::vector<CompiledEdge> &other_edges = (uncertainty.on_parent_branch_ ? setup.child_edges_ : setup.parent_edges_);
+
+			addCacheDependencies(branch_edges, 0, uncertainty.parent_node_, setup.parent_points_[j]);
+			addCacheDependencies(other_edges, 0, other_edges.size(), setup.parent_points_[j]);
+			addCacheDependencies(branch_edges, uncertainty.child_node_, branch_edges.size(), setup.child_points_[j]);
+			setup.parent_points_[j].valid_ = false;
+			setup.child_points_[j].valid_ = false;
+		}
+	}
+
+	return true;
+}
+
+bool CompiledSnapshots::collectPoints(const int setup_idx, const int uncertainty_idx, const std::vector<cv::Point3d> *&points_parent, const std::vector<cv::Point3d> *&points_child,
+										const std::vector<int> *&snapshot_begin, const std::vector<double> *&weights)
+{
+	if ( setup_idx < 0 || setup_idx >= setups_.size() || uncertainty_idx < 0 || uncertainty_idx >= setups_[setup_idx].uncertainties_.size() )
+		return false;
+
+	CompiledSetup &setup = setups_[setup_idx];
+	CompiledPointCache &parent_cache = setup.parent_points_[uncertainty_idx];
+	CompiledPointCache &child_cache = setup.child_points_[uncertainty_idx];
+	points_parent = &parent_cache.points_;
+	points_child = &child_cache.points_;
+	snapshot_begin = &parent_cache.snapshot_begin_;
+	weights = &parent_cache.weights_;
+
+	// only redo the chain products of the side whose uncertainties have changed
+	const bool update_parent = !isCacheCurrent(parent_cache);
+	const bool update_child = !isCacheCurrent(child_cache);
+	if ( !update_parent && !update_child )
+		return true;
+
+	if ( update_parent )
+	{
+		parent_cache.points_.clear();
+		parent_cache.weights_.clear();
+		parent_cache.snapshot_begin_.resize(setup.snapshots_.size()+1);
+	}
+	if ( update_child )
+	{
+		child_cache.points_.clear();
+		child_cache.snapshot_begin_.resize(setup.snapshots_.size()+1);
+	}
+
+	updatePrefixes(setup);
+
+	// both chains start at a node of the uncertainty and end at a branch end, so they are read off the prefixes directly
+	const CompiledUncertainty &uncertainty = uncertainties_[setup.uncertainties_[uncertainty_idx]];
+	const std::vector<int> &branch_nodes = setup.tree_.branch_nodes_[uncertainty.on_parent_branch_ ? 0 : 1];
+	const std::vector<int> &other_nodes = setup.tree_.branch_nodes_[uncertainty.on_parent_branch_ ? 1 : 0];
+	const int up_node = branch_nodes[uncertainty.parent_node_];  // up = uncertainty parent
+	const int uc_node = branch_nodes[uncertainty.child_node_];  // uc = uncertainty child
+	const int last_branch_node = branch_nodes.back();
+	const int last_otherbranch_node = ( other_nodes.empty() ? 0 : other_nodes.back() );
+
+	transform_utilities::RigidTransform up_to_last_otherbranch_frame;
+	transform_utilities::RigidTransform uc_to_last_branch_frame;
+	transform_utilities::RigidTransform to_marker;
+
+	for ( int i=0; i<setup.snapshots_.size(); ++i )
+	{
+		if ( update_parent )
+			parent_cache.snapshot_begin_[i] = parent_cache.points_.size();
+		if ( update_child )
+			child_cache.snapshot_begin_[i] = child_cache.points_.size();
+
+		const CompiledSnapshot &snapshot = setup.snapshots_[i];
+		if ( !snapshot.valid_ || snapshot.markers_[uncertainty_idx].empty() )
+			continue;
+
+		const std::vector<CompiledMarkerPair> &markers = snapshot.markers_[uncertainty_idx];
+
+		// parent marker points in uncertainty parent frame
+		if ( update_parent )
+		{
+			chainTransform(snapshot, up_node, last_otherbranch_node, up_to_last_otherbranch_frame);
+
+			for ( int j=0; j<markers.size(); ++j )
+			{
+				transform_utilities::composeTransforms(up_to_last_otherbranch_frame, markers[j].otherbranch_to_parent_marker_, to_marker);
+				transformPattern(to_marker, markers[j].parent_pattern_, parent_cache.points_);
+				parent_cache.weights_.resize(parent_cache.points_.size(), markers[j].weight_);
+			}
+		}
+
+		// child marker points in uncertainty child frame
+		if ( update_child )
+		{
+			chainTransform(snapshot, uc_node, last_branch_node, uc_to_last_branch_frame);
+
+			for ( int j=0; j<markers.size(); ++j )
+			{
+				transform_utilities::composeTransforms(uc_to_last_branch_frame, markers[j].branch_to_child_marker_, to_marker);
+				transformPattern(to_marker, markers[j].child_pattern_, child_cache.points_);
+			}
+		}
+	}
+
+	if ( update_parent )
+	{
+		parent_cache.snapshot_begin_.back() = parent_cache.points_.size();
+		markCacheCurrent(parent_cache);
+	}
+	if ( update_child )
+	{
+		child_cache.snapshot_begin_.back() = child_cache.points_.size();
+		markCacheCurrent(child_cache);
+	}
+
+	return true;
+}
+
+void CompiledSnapshots::updateUncertainty(const int setup_idx, const int uncertainty_idx, const transform_utilities::RigidTransform &trafo)
+{
+	CompiledUncertainty &uncertainty = uncertainties_[setups_[setup_idx].uncertainties_[uncertainty_idx]];
+	uncertainty.current_trafo_ = trafo;
+	uncertainty.calibrated_ = true;
+	++uncertainty.version_;
+}
+
+// one non-zero 3x6 jacobian block of a point residual: J = sign*[R | -R*[q]x] with q = S*pattern_point
+struct JacobianTerm
+{
+	int variable_;  // uncertainty index within setup
+	double sign_;
+	bool child_chain_;  // whether the block belongs to the chain ending at the child marker
+	const double* R_;  // rotation part of the chain from origin up to the perturbation (row-major 3x4)
+	transform_utilities::RigidTransform S_;  // trafo from marker to the frame the perturbation acts in
+};
+
+double CompiledSnapshots::evaluateSetup(const int setup_idx, cv::Mat *JtJ, cv::Mat *Jtr, int &residual_count) const
+{
+	residual_count = 0;
+	const CompiledSetup &setup = setups_[setup_idx];
+	const int dim = 6*setup.uncertainties_.size();
+	const bool accumulate = ( JtJ != 0 && Jtr != 0 );
+
+	if ( accumulate )
+	{
+		*JtJ = cv::Mat::zeros(dim, dim, CV_64FC1);
+		*Jtr = cv::Mat::zeros(dim, 1, CV_64FC1);
+	}
+
+	double cost = 0.;
+	double weight_sum = 0.;
+	const std::vector<CompiledEdge>* edges[2] = { &setup.parent_edges_, &setup.child_edges_ };  // [0]: parent branch, [1]: child branch
+	std::vector<transform_utilities::RigidTransform> trafos[2];
+	std::vector<transform_utilities::RigidTransform> prefixes[2];  // prefixes[b][i] = E_0*...*E_(i-1)
+	std::vector<transform_utilities::RigidTransform> inv_prefixes[2];
+	std::vector<JacobianTerm> terms;
+	std::vector<double> jacobians;  // 18 values per term
+	std::vector<cv::Point3d> child_points, parent_points;  // pattern points of the current marker pair in origin frame
+
+	for ( int i=0; i<setup.snapshots_.size(); ++i )
+	{
+		const CompiledSnapshot &snapshot = setup.snapshots_[i];
+		if ( !snapshot.valid_ )
+			continue;
+
+		resolveBranch(*edges[0], snapshot.parent_branch_, setup_idx, trafos[0]);
+		resolveBranch(*edges[1], snapshot.child_branch_, setup_idx, trafos[1]);
+		for ( int b=0; b<2; ++b )
+		{
+			prefixes[b].resize(trafos[b].size()+1);
+			inv_prefixes[b].resize(trafos[b].size()+1);
+			transform_utilities::setIdentity(prefixes[b][0]);
+			for ( int e=0; e<trafos[b].size(); ++e )
+				transform_utilities::composeTransforms(prefixes[b][e], trafos[b][e], prefixes[b][e+1]);
+			for ( int e=0; e<prefixes[b].size(); ++e )
+				transform_utilities::invertTransform(prefixes[b][e], inv_prefixes[b][e]);
+		}
+
+		for ( int u=0; u<setup.uncertainties_.size(); ++u )
+		{
+			const std::vector<CompiledMarkerPair> &markers = snapshot.markers_[u];
+			const int branch = ( uncertainties_[setup.uncertainties_[u]].on_parent_branch_ ? 0 : 1 );  // child markers hang on the uncertainty's branch
+
+			for ( int j=0; j<markers.size(); ++j )
+			{
+				const double w = markers[j].weight_;
+				transform_utilities::RigidTransform to_child_marker, to_parent_marker;  // both from origin
+				transform_utilities::composeTransforms(prefixes[branch].back(), markers[j].branch_to_child_marker_, to_child_marker);
+				transform_utilities::composeTransforms(prefixes[1-branch].back(), markers[j].otherbranch_to_parent_marker_, to_parent_marker);
+
+				const CompiledPattern &child_pattern = patterns_[markers[j].child_pattern_];
+				const CompiledPattern &parent_pattern = patterns_[markers[j].parent_pattern_];
+				const int num_points = std::min(child_pattern.x_.size(), parent_pattern.x_.size());
+				if ( num_points == 0 )
+					continue;
+
+				// transform both patterns to origin frame at once
+				child_points.resize(num_points);
+				parent_points.resize(num_points);
+				transform_utilities::transformPoints(to_child_marker, &child_pattern.x_[0], &child_pattern.y_[0], &child_pattern.z_[0], num_points, &child_points[0]);
+				transform_utilities::transformPoints(to_parent_marker, &parent_pattern.x_[0], &parent_pattern.y_[0], &parent_pattern.z_[0], num_points, &parent_points[0]);
+
+				// collect jacobian blocks of all optimized uncertainties on both chains
+				terms.clear();
+				if ( accumulate )
+				{
+					for ( int b=0; b<2; ++b )
+					{
+						const bool child_chain = ( b == branch );
+						for ( int e=0; e<edges[b]->size(); ++e )
+						{
+							const CompiledEdge &edge = (*edges[b])[e];
+							if ( edge.uncertainty_ < 0 || uncertainties_[edge.uncertainty_].setup_idx_ != setup_idx )
+								continue;
+
+							// the perturbation acts after the edge (T*Exp(d)) or before it for inverted edges (Exp(-d)*T^-1)
+							const int node = ( edge.inverted_ ? e : e+1 );
+							JacobianTerm term;
+							term.variable_ = uncertainties_[edge.uncertainty_].uncertainty_idx_;
+							term.sign_ = ( child_chain ? 1. : -1. ) * ( edge.inverted_ ? -1. : 1. );
+							term.child_chain_ = child_chain;
+							term.R_ = prefixes[b][node].data_;
+							transform_utilities::composeTransforms(inv_prefixes[b][node], (child_chain ? to_child_marker : to_parent_marker), term.S_);
+							terms.push_back(term);
+						}
+					}
+					jacobians.resize(18*terms.size());
+				}
+
+				for ( int k=0; k<num_points; ++k )
+				{
+					const double r[3] = { child_points[k].x - parent_points[k].x, child_points[k].y - parent_points[k].y, child_points[k].z - parent_points[k].z };
+					cost += w*(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]);
+					weight_sum += w;
+					++residual_count;
+
+					if ( terms.empty() )
+						continue;
+
+					// jacobian blocks of this point
+					for ( int t=0; t<terms.size(); ++t )
+					{
+						const JacobianTerm &term = terms[t];
+						const CompiledPattern &pattern = ( term.child_chain_ ? child_pattern : parent_pattern );
+						const double pt[3] = { pattern.x_[k], pattern.y_[k], pattern.z_[k] };
+						const double* S = term.S_.data_;
+						const double* R = term.R_;
+						const double q[3] = { S[0]*pt[0] + S[1]*pt[1] + S[2]*pt[2] + S[3],
+											  S[4]*pt[0] + S[5]*pt[1] + S[6]*pt[2] + S[7],
+											  S[8]*pt[0] + S[9]*pt[1] + S[10]*pt[2] + S[11] };
+						double* J = &jacobians[18*t];
+						for ( int v=0; v<3; ++v )
+						{
+							const double* row = R + 4*v;
+							J[6*v+0] = term.sign_*row[0];
+							J[6*v+1] = term.sign_*row[1];
+							J[6*v+2] = term.sign_*row[2];
+							J[6*v+3] = -term.sign_*(row[1]*q[2] - row[2]*q[1]);  // -R*[q]x
+							J[6*v+4] = -term.sign_*(row[2]*q[0] - row[0]*q[2]);
+							J[6*v+5] = -term.sign_*(row[0]*q[1] - row[1]*q[0]);
+						}
+					}
+
+					// accumulate normal equations, only blocks of uncertainties on the chains are touched
+					for ( int t=0; t<terms.size(); ++t )
+					{
+						const double* Ja = &jacobians[18*t];
+						const int offset_a = 6*terms[t].variable_;
+						double* g = Jtr->ptr<double>(offset_a);
+						for ( int m=0; m<6; ++m )
+							g[m] += w*(Ja[m]*r[0] + Ja[6+m]*r[1] + Ja[12+m]*r[2]);
+
+						for ( int s=0; s<terms.size(); ++s )
+						{
+							const double* Jb = &jacobians[18*s];
+							const int offset_b = 6*terms[s].variable_;
+							for ( int m=0; m<6; ++m )
+							{
+								double* H = JtJ->ptr<double>(offset_a+m) + offset_b;
+								for ( int n=0; n<6; ++n )
+									H[n] += w*(Ja[m]*Jb[n] + Ja[6+m]*Jb[6+n] + Ja[12+m]*Jb[12+n]);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// normalize the weights to a mean of one, so the cost stays a sum of squared distances [m^2] comparable to unweighted residuals
+	if ( weight_sum > 0. )
+	{
+		const double scale = residual_count/weight_sum;
+		cost *= scale;
+		if ( accumulate )
+		{
+			*JtJ *= scale;
+			*Jtr *= scale;
+		}
+	}
+
+	return cost;
+}
+
+void CompiledSnapshots::applyIncrement(const int setup_idx, const cv::Mat &delta)
+{
+	const CompiledSetup &setup = setups_[setup_idx];
+	transform_utilities::RigidTransform increment, updated;
+
+	for ( int i=0; i<setup.uncertainties_.size(); ++i )
+	{
+		CompiledUncertainty &uncertainty = uncertainties_[setup.uncertainties_[i]];
+		transform_utilities::twistToRigidTransform(delta.ptr<double>(6*i), increment);
+		transform_utilities::composeTransforms(uncertainty.current_trafo_, increment, updated);
+		uncertainty.current_trafo_ = updated;
+		uncertainty.calibrated_ = true;
+		++uncertainty.version_;
+	}
+}
+
+void CompiledSnapshots::getUncertaintyTrafos(const int setup_idx, std::vector<transform_utilities::RigidTransform> &trafos) const
+{
+	const CompiledSetup &setup = setups_[setup_idx];
+	trafos.resize(setup.uncertainties_.size());
+	for ( int i=0; i<setup.uncertainties_.size(); ++i )
+		trafos[i] = uncertainties_[setup.uncertainties_[i]].current_trafo_;
+}
+
+void CompiledSnapshots::setUncertaintyTrafos(const int setup_idx, const std::vector<transform_utilities::RigidTransform> &trafos)
+{
+	const CompiledSetup &setup = setups_[setup_idx];
+	for ( int i=0; i<setup.uncertainties_.size() && i<trafos.size(); ++i )
+	{
+		CompiledUncertainty &uncertainty = uncertainties_[setup.uncertainties_[i]];
+		uncertainty.current_trafo_ = trafos[i];
+		++uncertainty.version_;
+	}
+}
+
+void CompiledSnapshots::exportUncertainties(std::vector<CalibrationSetup> &setups) const
+{
+	for ( int i=0; i<uncertainties_.size(); ++i )
+	{
+		const CompiledUncertainty &uncertainty = uncertainties_[i];
+		CalibrationInfo &info = setups[uncertainty.setup_idx_].uncertainties_list_[uncertainty.uncertainty_idx_];
+		info.current_trafo_ = transform_utilities::rigidTransformToMat(uncertainty.current_trafo_);
+		info.calibrated_ = uncertainty.calibrated_;
+	}
+}
+
+void CompiledSnapshots::getIndependentSetupGroups(std::vector< std::vector<int> > &groups) const
+{
+	// union-find over setup indices
+	std::vector<int> root(setups_.size());
+	for ( int i=0; i<root.size(); ++i )
+		root[i] = i;
+
+	for ( int i=0; i<setups_.size(); ++i )
+	{
+		for ( int b=0; b<2; ++b )
+		{
+			const std::vector<CompiledEdge> &edges = ( b == 0 ? setups_[i].parent_edges_ : setups_[i].child_edges_ );
+			for ( int j=0; j<edges.size(); ++j )
+			{
+				if ( edges[j].uncertainty_ < 0 )
+					continue;
+
+				int a = i;
+				int c = uncertainties_[edges[j].uncertainty_].setup_idx_;
+				while ( root[a] != a )
+					a = root[a];
+				while ( root[c] != c )
+					c = root[c];
+				root[std::max(a, c)] = std::min(a, c);
+			}
+		}
+	}
+
+	groups.clear();
+	std::vector<int> group_of_root(setups_.size(), -1);
+	for ( int i=0; i<setups_.size(); ++i )
+	{
+		int r = i;
+		while ( root[r] != r )
+			r = root[r];
+
+		if ( group_of_root[r] < 0 )
+		{
+			group_of_root[r] = groups.size();
+			groups.push_back(std::vector<int>());
+		}
+		groups[group_of_root[r]].push_back(i);
+	}
+}
+
+int CompiledSnapshots::internPattern(const FrameId marker_frame, CalibrationInterface *calibration_interface)
+{
+	std::map<FrameId, int>::const_iterator it = pattern_ids_.find(marker_frame);
+	if ( it != pattern_ids_.end() )
+		return it->second;
+
+	std::vector<cv::Point3f> pattern_points_3d;
+	calibration_interface->getPatternPoints3D(FrameRegistry::name(marker_frame), pattern_points_3d);  // get pattern points of marker
+
+	CompiledPattern pattern;
+	pattern.x_.resize(pattern_points_3d.size());
+	pattern.y_.resize(pattern_points_3d.size());
+	pattern.z_.resize(pattern_points_3d.size());
+	pattern.mean_squared_radius_ = 0.0;
+	for ( int i=0; i<pattern_points_3d.size(); ++i )
+	{
+		pattern.x_[i] = pattern_points_3d[i].x;
+		pattern.y_[i] = pattern_points_3d[i].y;
+		pattern.z_[i] = pattern_points_3d[i].z;
+		pattern.mean_squared_radius_ += pattern.x_[i]*pattern.x_[i] + pattern.y_[i]*pattern.y_[i] + pattern.z_[i]*pattern.z_[i];
+	}
+	if ( pattern_points_3d.size() > 0 )
+		pattern.mean_squared_radius_ /= pattern_points_3d.size();
+
+	const int id = patterns_.size();
+	pattern_ids_[marker_frame] = id;
+	patterns_.push_back(pattern);
+	return id;
+}
+
+bool CompiledSnapshots::compileBranch(const std::vector<FrameId> &frames, std::vector<CompiledEdge> &edges)
+{
+	edges.clear();
+
+	for ( int i=0; i+1<frames.size(); ++i )
+	{
+		CompiledEdge edge;
+		edge.parent_id_ = frames[i];
+		edge.child_id_ = frames[i+1];
+		edge.uncertainty_ = findUncertainty(edge.parent_id_, edge.child_id_, edge.inverted_);
+		edges.push_back(edge);
+	}
+
+	return true;
+}
+
+bool CompiledSnapshots::compileBranchSnapshot(const std::vector<CompiledEdge> &edges, const std::vector<TFInfo> &branch, std::vector<transform_utilities::RigidTransform> &trafos) const
+{
+	trafos.resize(edges.size());
+
+	for ( int i=0; i<edges.size(); ++i )
+	{
+		const FrameId parent = edges[i].parent_id_;
+		const FrameId child = edges[i].child_id_;
+		bool found = false;
+
+		for ( int j=0; j<branch.size(); ++j )
+		{
+			if ( branch[j].transform_.empty() )
+				continue;
+
+			if ( branch[j].parent_ == parent && branch[j].child_ == child )  // in right order
+			{
+				transform_utilities::matToRigidTransform(branch[j].transform_, trafos[i]);
+				found = true;
+				break;
+			}
+			else if ( branch[j].parent_ == child && branch[j].child_ == parent )  // order swapped -> inverse
+			{
+				transform_utilities::RigidTransform trafo;
+				transform_utilities::matToRigidTransform(branch[j].transform_, trafo);
+				transform_utilities::invertTransform(trafo, trafos[i]);
+				found = true;
+				break;
+			}
+		}
+
+		if ( !found )
+		{
+			ROS_ERROR("CompiledSnapshots::compileBranchSnapshot - Could not retrieve transform from %s to %s in current snapshot", FrameRegistry::name(parent).c_str(), FrameRegistry::name(child).c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int CompiledSnapshots::findUncertainty(const FrameId parent_id, const FrameId child_id, bool &inverted) const
+{
+	inverted = false;
+
+	std::map<std::pair<FrameId, FrameId>, int>::const_iterator it = uncertainty_ids_.find(std::make_pair(parent_id, child_id));
+	if ( it != uncertainty_ids_.end() )
+		return it->second;
+
+	it = uncertainty_ids_.find(std::make_pair(child_id, parent_id));
+	if ( it != uncertainty_ids_.end() )
+	{
+		inverted = true;
+		return it->second;
+	}
+
+	return -1;
+}
+
+void CompiledSnapshots::buildKinematicTree(const CalibrationSetup &calibration_setup, CompiledSetup &setup) const
+{
+	CompiledKinematicTree &tree = setup.tree_;
+	tree = CompiledKinematicTree();
+
+	CompiledTreeNode root;
+	root.frame_id_ = calibration_setup.origin_;
+	root.parent_ = -1;
+	root.depth_ = 0;
+	root.branch_ = -1;
+	root.edge_ = -1;
+	root.uncertainty_ = -1;
+	tree.nodes_.push_back(root);
+	tree.node_ids_[root.frame_id_] = 0;
+
+	const std::vector<FrameId>* frames[2] = { &calibration_setup.parent_branch_, &calibration_setup.child_branch_ };
+	const std::vector<CompiledEdge>* edges[2] = { &setup.parent_edges_, &setup.child_edges_ };
+	for ( int b=0; b<2; ++b )
+	{
+		tree.branch_nodes_[b].resize(frames[b]->size());
+
+		int node = 0;  // both branches start at the origin
+		for ( int k=1; k<frames[b]->size(); ++k )
+		{
+			// a frame reached from the same parent node by both branches is shared
+			std::map<FrameId, int>::const_iterator it = tree.node_ids_.find((*frames[b])[k]);
+			if ( it != tree.node_ids_.end() && tree.nodes_[it->second].parent_ == node )
+			{
+				node = it->second;
+			}
+			else
+			{
+				CompiledTreeNode child;
+				child.frame_id_ = (*frames[b])[k];
+				child.parent_ = node;
+				child.depth_ = tree.nodes_[node].depth_ + 1;
+				child.branch_ = b;
+				child.edge_ = k-1;
+				child.uncertainty_ = (*edges[b])[k-1].uncertainty_;
+
+				node = tree.nodes_.size();
+				if ( child.uncertainty_ >= 0 )
+					tree.uncertain_nodes_.push_back(node);
+				tree.node_ids_[child.frame_id_] = node;
+				tree.nodes_.push_back(child);
+			}
+
+			tree.branch_nodes_[b][k] = node;
+		}
+	}
+}
+
+void CompiledSnapshots::updatePrefixes(CompiledSetup &setup) const
+{
+	if ( isCacheCurrent(setup.prefix_state_) )
+		return;
+
+	const std::vector<CompiledTreeNode> &nodes = setup.tree_.nodes_;
+	transform_utilities::RigidTransform buffer;
+	for ( int i=0; i<setup.snapshots_.size(); ++i )
+	{
+		CompiledSnapshot &snapshot = setup.snapshots_[i];
+		if ( !snapshot.valid_ )
+			continue;
+
+		snapshot.prefixes_.resize(nodes.size());
+		transform_utilities::setIdentity(snapshot.prefixes_[0]);
+		for ( int n=1; n<nodes.size(); ++n )  // parents precede their children
+		{
+			const CompiledTreeNode &node = nodes[n];
+			const CompiledEdge &edge = (node.branch_ == 0 ? setup.parent_edges_ : setup.child_edges_)[node.edge_];
+			const transform_utilities::RigidTransform &snapshotted = (node.branch_ == 0 ? snapshot.parent_branch_ : snapshot.child_branch_)[node.edge_];
+			transform_utilities::composeTransforms(snapshot.prefixes_[node.parent_], edgeTransform(edge, snapshotted, buffer), snapshot.prefixes_[n]);
+		}
+	}
+
+	markCacheCurrent(setup.prefix_state_);
+}
+
+void CompiledSnapshots::chainTransform(const CompiledSnapshot &snapshot, const int from, const int to, transform_utilities::RigidTransform &result) const
+{
+	// T_from_to = inv(T_root_from) * T_root_to
+	if ( from == 0 )
+	{
+		result = snapshot.prefixes_[to];
+		return;
+	}
+
+	transform_utilities::RigidTransform from_to_root;
+	transform_utilities::invertTransform(snapshot.prefixes_[from], from_to_root);
+	transform_utilities::composeTransforms(from_to_root, snapshot.prefixes_[to], result);
+}
+
+void CompiledSnapshots::addCacheDependencies(const std::vector<CompiledEdge> &edges, const int begin, const int end, CompiledCacheState &cache) const
+{
+	for ( int i=begin; i<end; ++i )
+	{
+		if ( edges[i].uncertainty_ >= 0 && std::find(cache.dependencies_.begin(), cache.dependencies_.end(), edges[i].uncertainty_) == cache.dependencies_.end() )
+			cache.dependencies_.push_back(edges[i].uncertainty_);
+	}
+	cache.versions_.assign(cache.dependencies_.size(), 0);
+}
+
+bool CompiledSnapshots::isCacheCurrent(const CompiledCacheState &cache) const
+{
+	if ( !cache.valid_ )
+		return false;
+
+	for ( int i=0; i<cache.dependencies_.size(); ++i )
+	{
+		if ( uncertainties_[cache.dependencies_[i]].version_ != cache.versions_[i] )
+			return false;
+	}
+	return true;
+}
+
+void CompiledSnapshots::markCacheCurrent(CompiledCacheState &cache) const
+{
+	for ( int i=0; i<cache.dependencies_.size(); ++i )
+		cache.versions_[i] = uncertainties_[cache.dependencies_[i]].version_;
+	cache.valid_ = true;
+}
+
+const transform_utilities::RigidTransform& CompiledSnapshots::edgeTransform(const CompiledEdge &edge, const transform_utilities::RigidTransform &snapshotted, transform_utilities::RigidTransform &buffer) const
+{
+	// calibrated uncertainties are used instead of what's in the snapshot
+	if ( edge.uncertainty_ >= 0 && uncertainties_[edge.uncertainty_].calibrated_ )
+	{
+		if ( !edge.inverted_ )
+			return uncertainties_[edge.uncertainty_].current_trafo_;
+
+		transform_utilities::invertTransform(uncertainties_[edge.uncertainty_].current_trafo_, buffer);
+		return buffer;
+	}
+
+	return snapshotted;
+}
+
+void CompiledSnapshots::resolveBranch(const std::vector<CompiledEdge> &edges, const std::vector<transform_utilities::RigidTransform> &snapshotted, const int optimized_setup_idx, std::vector<transform_utilities::RigidTransform> &trafos) const
+{
+	trafos.resize(edges.size());
+
+	transform_utilities::RigidTransform buffer;
+	for ( int i=0; i<edges.size(); ++i )
+	{
+		const CompiledEdge &edge = edges[i];
+		if ( edge.uncertainty_ >= 0 && uncertainties_[edge.uncertainty_].setup_idx_ == optimized_setup_idx )
+		{
+			if ( edge.inverted_ )
+				transform_utilities::invertTransform(uncertainties_[edge.uncertainty_].current_trafo_, trafos[i]);
+			else
+				trafos[i] = uncertainties_[edge.uncertainty_].current_trafo_;
+		}
+		else
+			trafos[i] = edgeTransform(edge, snapshotted[i], buffer);
+	}
+}
+
+void CompiledSnapshots::transformPattern(const transform_utilities::RigidTransform &T, const int pattern_idx, std::vector<cv::Point3d> &points) const
+{
+	const CompiledPattern &pattern = patterns_[pattern_idx];
+	const int offset = points.size();
+	points.resize(offset + pattern.x_.size());
+
+	if ( !pattern.x_.empty() )
+		transform_utilities::transformPoints(T, &pattern.x_[0], &pattern.y_[0], &pattern.z_[0], pattern.x_.size(), &points[offset]);
+}
@@ -0,0 +1,400 @@
+/****************************************************************
+ *
+ * Copyright (c) 2015
+ *
+ * Fraunhofer Institute for Manufacturing Engineering
+ * and Automation (IPA)
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Project name: squirrel
+ * ROS stack name: squirrel_calibration
+ * ROS package name: robotino_calibration
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Author: Marc Riedlinger, email:marc.riedlinger@ipa.fraunhofer.de
+ *
+ * Date of creation: October 2026
+ *
+ * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Fraunhofer Institute for Manufacturing
+ *       Engineering and Automation (IPA) nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License LGPL as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License LGPL for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License LGPL along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************/
+
+#include <robotino_calibration/configuration_selector.h>
+#include <robotino_calibration/compiled_snapshots.h>
+#include <robotino_calibration/transformation_utilities.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ros/ros.h>
+
+
+ConfigurationSelector::ConfigurationSelector() :
+	configuration_spacing_(0.0), visited_count_(0), initial_configurations_(1), translation_precision_(0.0), rotation_precision_(0.0)
+{
+}
+
+ConfigurationSelector::~ConfigurationSelector()
+{
+}
+
+void ConfigurationSelector::initialize(const std::vector< std::vector<double> > &parameters, const int initial_configurations, const double translation_precision, const double rotation_precision)
+{
+	parameters_ = parameters;
+	visited_.assign(parameters_.size(), false);
+	visited_count_ = 0;
+	initial_configurations_ = std::max(initial_configurations, 1);
+	translation_precision_ = translation_precision;
+	rotation_precision_ = rotation_precision;
+	information_.assign(parameters_.size(), std::vector<cv::Mat>());
+	total_information_.clear();
+	registrations_.clear();
+	converged_.clear();
+
+	// normalize each parameter by its range, so that joint angles and base positions are comparable
+	parameter_scales_.clear();
+	for ( int i=0; i<parameters_.size(); ++i )
+	{
+		for ( int j=0; j<parameters_[i].size(); ++j )
+		{
+			if ( j >= parameter_scales_.size() )
+				parameter_scales_.resize(j+1, 0.0);
+		}
+	}
+	for ( int j=0; j<parameter_scales_.size(); ++j )
+	{
+		double min_value = std::numeric_limits<double>::max();
+		double max_value = -std::numeric_limits<double>::max();
+		for ( int i=0; i<parameters_.size(); ++i )
+		{
+			if ( j < parameters_[i].size() )
+			{
+				min_value = std::min(min_value, parameters_[i][j]);
+				max_value = std::max(max_value, parameters_[i][j]);
+			}
+		}
+		parameter_scales_[j] = ( max_value > min_value ? 1.0/(max_value-min_value) : 0.0 );
+	}
+
+	configuration_spacing_ = 0.0;
+	for ( int i=0; i<parameters_.size() && parameters_.size() > 1; ++i )
+	{
+		double nearest = std::numeric_limits<double>::max();
+		for ( int j=0; j<parameters_.size(); ++j )
+		{
+			if ( j != i )
+				nearest = std::min(nearest, getDistance(i, j));
+		}
+		configuration_spacing_ += nearest/parameters_.size();
+	}
+}
+
+void ConfigurationSelector::markVisited(const int config_index)
+{
+	if ( config_index < 0 || config_index >= visited_.size() || visited_[config_index] )
+		return;
+
+	visited_[config_index] = true;
+	++visited_count_;
+}
+
+bool ConfigurationSelector::update(const std::vector<CalibrationSetup> &setups, const std::vector<TFSnapshot> &snapshot, const int config_index, CalibrationInterface *calibration_interface)
+{
+	if ( config_index < 0 || config_index >= information_.size() )
+	{
+		ROS_ERROR("ConfigurationSelector::update - Invalid configuration index %d.", config_index);
+		return false;
+	}
+
+	// the points of a snapshot depend on the initial estimates of the uncertainties only, so earlier snapshots need not be compiled again
+	CompiledSnapshots compiled;
+	if ( !compiled.compile(setups, std::vector< std::vector<TFSnapshot> >(1, snapshot), calibration_interface) )
+		return false;
+
+	int uncertainty_count = 0;
+	for ( int i=0; i<setups.size(); ++i )
+		uncertainty_count += setups[i].uncertainties_list_.size();
+
+	if ( total_information_.size() != uncertainty_count )
+	{
+		total_information_.resize(uncertainty_count);
+		for ( int u=0; u<uncertainty_count; ++u )
+			total_information_[u] = cv::Mat::zeros(6, 6, CV_64FC1);
+		registrations_.assign(uncertainty_count, RegistrationSums());
+	}
+	converged_.assign(uncertainty_count, false);
+
+	std::vector<cv::Mat> &information = information_[config_index];
+	information.resize(uncertainty_count);
+	for ( int u=0; u<uncertainty_count; ++u )
+		information[u] = cv::Mat::zeros(6, 6, CV_64FC1);
+
+	int u = 0;  // uncertainty index over all setups
+	for ( int i=0; i<setups.size(); ++i )
+	{
+		for ( int j=0; j<setups[i].uncertainties_list_.size(); ++j, ++u )
+		{
+			const std::vector<cv::Point3d> *points_parent = 0;
+			const std::vector<cv::Point3d> *points_child = 0;
+			const std::vector<int> *snapshot_begin = 0;
+			const std::vector<double> *weights = 0;
+			if ( compiled.collectPoints(i, j, points_parent, points_child, snapshot_begin, weights) && points_parent->size() == points_child->size() )
+			{
+				// information = sum w*J^T*J, J being the jacobian of the registration residual w.r.t. a perturbation of the uncertainty
+				RegistrationSums &sums = registrations_[u];
+				for ( int p=0; p<points_child->size(); ++p )
+				{
+					const cv::Point3d &parent = (*points_parent)[p];
+					const cv::Point3d &child = (*points_child)[p];
+					const double weight = (*weights)[p];
+					addPointInformation(child, weight, information[u]);
+					sums.accumulator_.add(parent, child, weight);
+					sums.weight_sum_ += weight;
+					sums.squared_norm_sum_parent_ += weight*parent.dot(parent);
+					sums.squared_norm_sum_child_ += weight*child.dot(child);
+				}
+				total_information_[u] += information[u];
+			}
+
+			// standard deviations of the estimate are the square roots of the covariance diagonal
+			cv::Mat covariance;
+			if ( cv::invert(total_information_[u], covariance, cv::DECOMP_CHOLESKY) == 0 )
+				continue;
+			covariance *= getVarianceFactor(registrations_[u]);
+
+			double translation_std = 0.0, rotation_std = 0.0;
+			for ( int d=0; d<3; ++d )
+			{
+				translation_std = std::max(translation_std, std::sqrt(std::max(covariance.at<double>(d,d), 0.0)));
+				rotation_std = std::max(rotation_std, std::sqrt(std::max(covariance.at<double>(d+3,d+3), 0.0)));
+			}
+			converged_[u] = ( translation_std <= translation_precision_ && rotation_std <= rotation_precision_ );
+
+			std::cout << "Uncertainty from " << FrameRegistry::name(setups[i].uncertainties_list_[j].parent_) << " to " << FrameRegistry::name(setups[i].uncertainties_list_[j].child_)
+					  << ": translation std " << translation_std << " m, rotation std " << rotation_std << " rad" << std::endl;
+		}
+	}
+
+	return true;
+}
+
+double ConfigurationSelector::getVarianceFactor(const RegistrationSums &sums) const
+{
+	const int redundancy = 3*sums.accumulator_.getCount() - 6;
+	transform_utilities::RigidTransform T;
+	if ( redundancy <= 0 || !sums.accumulator_.computeTransform(T) )
+		return 1.0;
+
+	// sum w*|R*(c-c_child) - (p-c_parent)|^2 of the registration, expanded into the accumulated sums
+	cv::Point3d centroid_parent, centroid_child;
+	sums.accumulator_.getCentroids(centroid_parent, centroid_child);
+	double M[9];
+	sums.accumulator_.getCrossCovariance(M);  // sum w*(c-c_child)*(p-c_parent)^T
+
+	double correlation = 0.0;  // sum w*(p-c_parent)^T*R*(c-c_child)
+	for ( int r=0; r<3; ++r )
+		for ( int c=0; c<3; ++c )
+			correlation += T.data_[4*r+c]*M[3*c+r];
+
+	const double weighted_squared_residuals = sums.squared_norm_sum_parent_ - sums.weight_sum_*centroid_parent.dot(centroid_parent)
+											+ sums.squared_norm_sum_child_ - sums.weight_sum_*centroid_child.dot(centroid_child) - 2.0*correlation;
+	return std::max(weighted_squared_residuals, 0.0)/redundancy;
+}
+
+bool ConfigurationSelector::isPrecisionReached() const
+{
+	if ( visited_count_ < initial_configurations_ || converged_.empty() )
+		return false;
+
+	return ( std::find(converged_.begin(), converged_.end(), false) == converged_.end() );
+}
+
+int ConfigurationSelector::selectNext(const int current_config, CalibrationInterface *calibration_interface) const
+{
+	if ( visited_count_ >= visited_.size() )
+		return -1;
+
+	// a transition the robot refuses (e.g. a joint exceeding its max delta angle) burns all move tries without producing a snapshot
+	std::vector<bool> candidates(visited_.size(), false);
+	bool any_candidate = false;
+	for ( int i=0; i<visited_.size(); ++i )
+	{
+		candidates[i] = ( !visited_[i] && (current_config < 0 || calibration_interface == 0 || calibration_interface->isTransitionFeasible(current_config, i)) );
+		any_candidate |= candidates[i];
+	}
+
+	if ( !any_candidate )  // every remaining configuration would be refused, try them anyway
+	{
+		for ( int i=0; i<visited_.size(); ++i )
+			candidates[i] = !visited_[i];
+	}
+
+	if ( visited_count_ < initial_configurations_ || total_information_.empty() )
+		return getFarthestConfiguration(candidates);
+
+	// uncertainties that have reached their target precision do not need further information
+	std::vector<double> current_log_determinants(total_information_.size(), 0.0);
+	for ( int u=0; u<total_information_.size(); ++u )
+	{
+		if ( !converged_[u] )
+			current_log_determinants[u] = getLogDeterminant(total_information_[u]);
+	}
+
+	int best_config = -1;
+	double best_gain = 0.0;
+	std::vector<cv::Mat> predicted_information(total_information_.size());
+	for ( int i=0; i<visited_.size(); ++i )
+	{
+		if ( !candidates[i] )
+			continue;
+
+		// predict the information of configuration i by inverse distance weighting of the visited configurations,
+		// those without a snapshot (no markers seen) contribute no information
+		for ( int u=0; u<total_information_.size(); ++u )
+			predicted_information[u] = cv::Mat::zeros(6, 6, CV_64FC1);
+
+		double weight_sum = 0.0;
+		double closest_distance = std::numeric_limits<double>::max();
+		for ( int j=0; j<visited_.size(); ++j )
+		{
+			if ( !visited_[j] )
+				continue;
+
+			const double distance = getDistance(i, j);
+			closest_distance = std::min(closest_distance, distance);
+			const double weight = 1.0/(distance*distance + 1e-12);
+			weight_sum += weight;
+			for ( int u=0; u<information_[j].size() && u<total_information_.size(); ++u )
+				predicted_information[u] += weight*information_[j][u];
+		}
+
+		if ( weight_sum <= 0.0 )
+			continue;
+
+		// expected reduction of the covariance volumes, log(det(I_total + I_predicted) / det(I_total))
+		double gain = 0.0;
+		for ( int u=0; u<total_information_.size(); ++u )
+		{
+			if ( !converged_[u] )
+				gain += getLogDeterminant(total_information_[u] + predicted_information[u]*(1.0/weight_sum)) - current_log_determinants[u];
+		}
+
+		// a configuration next to a visited one mostly repeats its viewpoint, the discount fades out within about one configuration spacing
+		if ( configuration_spacing_ > 0.0 )
+			gain *= 1.0 - std::exp(-(closest_distance*closest_distance)/(configuration_spacing_*configuration_spacing_));
+
+		if ( gain > best_gain )
+		{
+			best_gain = gain;
+			best_config = i;
+		}
+	}
+
+	// nothing is expected to help, explore the least known region of the configuration space instead
+	if ( best_config < 0 )
+		return getFarthestConfiguration(candidates);
+
+	return best_config;
+}
+
+double ConfigurationSelector::getDistance(const int config_a, const int config_b) const
+{
+	const std::vector<double> &a = parameters_[config_a];
+	const std::vector<double> &b = parameters_[config_b];
+
+	if ( a.empty() || a.size() != b.size() )  // no parameters available, neighboring indices are assumed to be similar configurations
+		return std::fabs((double)(config_a-config_b))/std::max<int>(parameters_.size(), 1);
+
+	double squared_distance = 0.0;
+	for ( int i=0; i<a.size(); ++i )
+	{
+		const double delta = (a[i]-b[i])*parameter_scales_[i];
+		squared_distance += delta*delta;
+	}
+
+	return std::sqrt(squared_distance);
+}
+
+int ConfigurationSelector::getFarthestConfiguration(const std::vector<bool> &candidates) const
+{
+	int farthest = -1;
+	double farthest_distance = -1.0;
+	for ( int i=0; i<visited_.size(); ++i )
+	{
+		if ( !candidates[i] )
+			continue;
+
+		if ( visited_count_ == 0 )  // start with the first configuration
+			return i;
+
+		double distance = std::numeric_limits<double>::max();
+		for ( int j=0; j<visited_.size(); ++j )
+		{
+			if ( visited_[j] )
+				distance = std::min(distance, getDistance(i, j));
+		}
+
+		if ( distance > farthest_distance )
+		{
+			farthest_distance = distance;
+			farthest = i;
+		}
+	}
+
+	return farthest;
+}
+
+void ConfigurationSelector::addPointInformation(const cv::Point3d &point, const double weight, cv::Mat &information) const
+{
+	// J = R*[I | -[p]x] for a perturbation of the uncertainty from the right, R cancels out in J^T*J
+	const double skew[3][3] = { { 0.0, -point.z, point.y }, { point.z, 0.0, -point.x }, { -point.y, point.x, 0.0 } };
+	const double squared_norm = point.dot(point);
+	const double p[3] = { point.x, point.y, point.z };
+
+	for ( int i=0; i<3; ++i )
+	{
+		information.at<double>(i,i) += weight;
+		for ( int j=0; j<3; ++j )
+		{
+			information.at<double>(i,j+3) -= weight*skew[i][j];
+			information.at<double>(i+3,j) += weight*skew[i][j];
+			information.at<double>(i+3,j+3) += weight*((i == j ? squared_norm : 0.0) - p[i]*p[j]);  // [p]x^T*[p]x
+		}
+	}
+}
+
+double ConfigurationSelector::getLogDeterminant(const cv::Mat &information) const
+{
+	// small regularization keeps the determinant of rank deficient information matrices (e.g. no markers seen yet) finite
+	const double regularization = 1e-9*(cv::trace(information)[0]/6.0 + 1.0);
+	const double determinant = cv::determinant(information + regularization*cv::Mat::eye(6, 6, CV_64FC1));
+	return std::log(std::max(determinant, std::numeric_limits<double>::min()));
+}
@@ -54,18 +54,27 @@
 
 //Exception
 #include <exception>
+#include <algorithm>
+#include <deque>
+#include <set>
 
 #include <sstream>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include <robotino_calibration/time_utilities.h>
+#include <robotino_calibration/snapshot_store.h>
+#include <robotino_calibration/configuration_selector.h>
+#include <boost/filesystem.hpp>
 
 
 // ToDo: Create custom exception classes for exception handling
-// ToDo: Save snapshots one by one instead of just once at the end -> ability to restore current routine after crash
 // ToDo: Rename package to libextrinsic_calibration, also in CMakeList (but without lib tag there)
 
 
 RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* interface, const bool load_data_from_disk) :
-	node_handle_(nh), transform_listener_(nh), calibrated_(false), calibration_interface_(interface), load_data_from_disk_(load_data_from_disk), transform_discard_timeout_(1.0)
+	node_handle_(nh), transform_listener_(nh), calibrated_(false), calibration_interface_(interface), load_data_from_disk_(load_data_from_disk), transform_discard_timeout_(1.0), resume_acquisition_(false), tf_samples_(1), tf_sample_interval_(0.1), tf_max_wait_(1.0),
+	settle_detection_(true), settle_window_(1.0), settle_translation_threshold_(0.001), settle_rotation_threshold_(0.002), active_sampling_(false),
+	active_initial_configurations_(5), active_translation_precision_(0.0005), active_rotation_precision_(0.001), frame_graph_timeout_(5.0)
 {
 	// load parameters
 	std::cout << std::endl << "========== RobotCalibration Parameters ==========" << std::endl;
@@ -84,6 +93,64 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 	}
 	std::cout << "optimization_iterations: " << optimization_iterations_ << std::endl;
 
+	node_handle_.param<std::string>("optimization_method", optimization_method_, "alternating");
+	if ( optimization_method_.compare("alternating") != 0 && optimization_method_.compare("joint") != 0 )
+	{
+		std::cout << "Invalid optimization_method value: " << optimization_method_ << " -> Setting value to alternating." << std::endl;
+		optimization_method_ = "alternating";
+	}
+	std::cout << "optimization_method: " << optimization_method_ << std::endl;
+
+	std::string robust_loss;
+	node_handle_.param<std::string>("robust_estimation", robust_loss, "none");
+	robust_estimation_ = true;
+	if ( robust_loss.compare("huber") == 0 )
+		robust_loss_ = transform_utilities::LOSS_HUBER;
+	else if ( robust_loss.compare("cauchy") == 0 )
+		robust_loss_ = transform_utilities::LOSS_CAUCHY;
+	else if ( robust_loss.compare("ransac") == 0 )
+		robust_loss_ = transform_utilities::LOSS_NONE;
+	else
+	{
+		if ( robust_loss.compare("none") != 0 )
+		{
+			std::cout << "Invalid robust_estimation value: " << robust_loss << " -> Setting value to none." << std::endl;
+			robust_loss = "none";
+		}
+		robust_loss_ = transform_utilities::LOSS_NONE;
+		robust_estimation_ = false;
+	}
+	std::cout << "robust_estimation: " << robust_loss << std::endl;
+
+	node_handle_.param("robust_inlier_threshold", robust_inlier_threshold_, 0.01);
+	if ( robust_inlier_threshold_ <= 0.0 )
+	{
+		std::cout << "Invalid robust_inlier_threshold value: " << robust_inlier_threshold_ << " -> Setting value to 0.01." << std::endl;
+		robust_inlier_threshold_ = 0.01;
+	}
+	std::cout << "robust_inlier_threshold: " << robust_inlier_threshold_ << std::endl;
+
+	node_handle_.param("ransac_hypotheses", ransac_hypotheses_, 100);
+	ransac_hypotheses_ = std::max(ransac_hypotheses_, 1);
+	std::cout << "ransac_hypotheses: " << ransac_hypotheses_ << std::endl;
+
+	node_handle_.param("optimization_threads", optimization_threads_, 0);
+	if ( optimization_threads_ <= 0 )  // use all cores
+		optimization_threads_ = std::max(1, (int)boost::thread::hardware_concurrency());
+	std::cout << "optimization_threads: " << optimization_threads_ << std::endl;
+
+	node_handle_.param("convergence_translation_threshold", convergence_translation_threshold_, 1e-6);
+	convergence_translation_threshold_ = fmax(convergence_translation_threshold_, 0.0);
+	std::cout << "convergence_translation_threshold: " << convergence_translation_threshold_ << std::endl;
+
+	node_handle_.param("convergence_rotation_threshold", convergence_rotation_threshold_, 1e-6);
+	convergence_rotation_threshold_ = fmax(convergence_rotation_threshold_, 0.0);
+	std::cout << "convergence_rotation_threshold: " << convergence_rotation_threshold_ << std::endl;
+
+	node_handle_.param("convergence_residual_threshold", convergence_residual_threshold_, 1e-8);
+	convergence_residual_threshold_ = fmax(convergence_residual_threshold_, 0.0);
+	std::cout << "convergence_residual_threshold: " << convergence_residual_threshold_ << std::endl;
+
 	node_handle_.param<std::string>("calibration_storage_path", calibration_storage_path_, "/calibration");
 	std::cout << "calibration_storage_path: " << calibration_storage_path_ << std::endl;
 
@@ -91,6 +158,8 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 	calib_data_file_name_ = calibration_interface_->getFileName("offline_data", false);
 	if ( calib_data_file_name_.empty() )
 		calib_data_file_name_ = "offline_data";
+	calib_snapshot_file_name_ = calib_data_file_name_ + "_snapshots.bin";
+	calib_journal_file_name_ = calib_data_file_name_ + "_journal.bin";
 	calib_data_file_name_ += ".txt";
 
 	// create folders that will contain calibration result and snapshot files for offline calibration
@@ -104,6 +173,53 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 		transform_discard_timeout_ = fmax(transform_discard_timeout_, 0.1);
 		std::cout << "transform_discard_timeout: " << transform_discard_timeout_ << std::endl;
 
+		node_handle_.param("resume_acquisition", resume_acquisition_, false);
+		std::cout << "resume_acquisition: " << resume_acquisition_ << std::endl;
+
+		node_handle_.param("tf_samples", tf_samples_, 1);
+		tf_samples_ = std::max(tf_samples_, 1);
+		std::cout << "tf_samples: " << tf_samples_ << std::endl;
+
+		node_handle_.param("tf_sample_interval", tf_sample_interval_, 0.1);
+		tf_sample_interval_ = fmax(tf_sample_interval_, 0.0);
+		std::cout << "tf_sample_interval: " << tf_sample_interval_ << std::endl;
+
+		node_handle_.param("tf_max_wait", tf_max_wait_, 1.0);
+		tf_max_wait_ = fmax(tf_max_wait_, 0.0);
+		std::cout << "tf_max_wait: " << tf_max_wait_ << std::endl;
+
+		node_handle_.param("settle_detection", settle_detection_, true);
+		std::cout << "settle_detection: " << settle_detection_ << std::endl;
+
+		node_handle_.param("settle_window", settle_window_, 1.0);
+		settle_window_ = fmax(settle_window_, 0.1);
+		std::cout << "settle_window: " << settle_window_ << std::endl;
+
+		node_handle_.param("settle_translation_threshold", settle_translation_threshold_, 0.001);
+		std::cout << "settle_translation_threshold: " << settle_translation_threshold_ << std::endl;
+
+		node_handle_.param("settle_rotation_threshold", settle_rotation_threshold_, 0.002);
+		std::cout << "settle_rotation_threshold: " << settle_rotation_threshold_ << std::endl;
+
+		node_handle_.param("active_sampling", active_sampling_, false);
+		std::cout << "active_sampling: " << active_sampling_ << std::endl;
+
+		node_handle_.param("active_initial_configurations", active_initial_configurations_, 5);
+		active_initial_configurations_ = std::max(active_initial_configurations_, 1);
+		std::cout << "active_initial_configurations: " << active_initial_configurations_ << std::endl;
+
+		node_handle_.param("active_translation_precision", active_translation_precision_, 0.0005);
+		active_translation_precision_ = fmax(active_translation_precision_, 0.0);
+		std::cout << "active_translation_precision: " << active_translation_precision_ << std::endl;
+
+		node_handle_.param("active_rotation_precision", active_rotation_precision_, 0.001);
+		active_rotation_precision_ = fmax(active_rotation_precision_, 0.0);
+		std::cout << "active_rotation_precision: " << active_rotation_precision_ << std::endl;
+
+		node_handle_.param("frame_graph_timeout", frame_graph_timeout_, 5.0);
+		frame_graph_timeout_ = fmax(frame_graph_timeout_, 0.0);
+		std::cout << "frame_graph_timeout: " << frame_graph_timeout_ << std::endl;
+
 		// hack to fix tf::waitForTransform throwing error that transforms do not exist when now() == 0 at startup
 		ROS_INFO("RobotCalibration::RobotCalibration - Waiting for TF listener to initialize...");
 		const double start_time = time_utilities::getSystemTimeSec();
@@ -129,6 +245,14 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 		if ( uncertainties_list.size() % 6 != 0 )
 			ROS_WARN("RobotCalibration::RobotCalibration - Size of uncertainsties_list is not a factor of 6: [parent frame, child frame, last parent-branch frame, last child-branch frame, parent marker, child marker]");
 
+		// wait once for all frames the calibration setups are built from, all queries below run on the captured frame graph
+		std::vector<std::string> required_frames;
+		for ( int i=0; i+3<uncertainties_list.size(); i+=6 )
+			required_frames.insert(required_frames.end(), uncertainties_list.begin()+i, uncertainties_list.begin()+i+4);
+
+		if ( !captureFrameGraph(required_frames, frame_graph_timeout_) )
+			ROS_WARN("RobotCalibration::RobotCalibration - Not all frames of the uncertainties list are available in tf after %f s, affected uncertainties will be skipped.", frame_graph_timeout_);
+
 		// create calibration setups, check for errors
 		for ( int i=0; i<uncertainties_list.size(); i+=6 )
 		{
@@ -137,29 +261,26 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 			std::string last_parent_branch_frame = uncertainties_list[i+2];
 			std::string last_child_branch_frame = uncertainties_list[i+3];
 
-			bool success = transform_listener_.waitForTransform(parent, child, ros::Time(0), ros::Duration(1.0));
-			if ( !success )
+			if ( !areFramesConnected(parent, child) )
 			{
 				ROS_ERROR("RobotCalibration::RobotCalibration - Transform from parent frame %s to child frame %s does not exist, skipping.", parent.c_str(), child.c_str());
 				continue;
 			}
 
-			success = transform_listener_.waitForTransform(parent, last_parent_branch_frame, ros::Time(0), ros::Duration(1.0));
-			if ( !success )
+			if ( !areFramesConnected(parent, last_parent_branch_frame) )
 			{
 				ROS_ERROR("RobotCalibration::RobotCalibration - Transform from parent frame %s to last parent-branch frame %s does not exist, skipping.", parent.c_str(), last_parent_branch_frame.c_str());
 				continue;
 			}
 
-			success = transform_listener_.waitForTransform(child, last_child_branch_frame, ros::Time(0), ros::Duration(1.0));
-			if ( !success )
+			if ( !areFramesConnected(child, last_child_branch_frame) )
 			{
 				ROS_ERROR("RobotCalibration::RobotCalibration - Transform from child frame %s to last child-branch frame %s does not exist, skipping.", child.c_str(), last_child_branch_frame.c_str());
 				continue;
 			}
 
 			std::string actual_parent = "";
-			transform_listener_.getParent(child, ros::Time(0), actual_parent);
+			getFrameParent(child, actual_parent);
 			if ( actual_parent.compare(parent) == 0 )  // compare actual parent of child with parent user has input
 			{
 				// get origin frame of parent and child branch chain
@@ -167,16 +288,19 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 				std::string origin = "";
 				if ( getOrigin(last_parent_branch_frame, last_child_branch_frame, origin) )
 				{
-					std::string parent_marker = uncertainties_list[i+4];
-					std::string child_marker = uncertainties_list[i+5];
+					const FrameId parent_id = FrameRegistry::intern(parent);
+					const FrameId child_id = FrameRegistry::intern(child);
+					const FrameId origin_id = FrameRegistry::intern(origin);
+					const FrameId parent_marker = FrameRegistry::intern(uncertainties_list[i+4]);
+					const FrameId child_marker = FrameRegistry::intern(uncertainties_list[i+5]);
 
 					bool found = false;
 					for ( int j=0; j<calibration_setups_.size(); ++j )  // merge entries that have the origin
 					{
 						// check if uncertainty lies on parent or child branch of any existing setup, if so, merge, otherwise create a new calibration setup
-						if ( isPartOfCalibrationSetup(parent, child, origin, calibration_setups_[j]) )
+						if ( isPartOfCalibrationSetup(parent_id, child_id, origin_id, calibration_setups_[j]) )
 						{
-							feedCalibrationSetup(calibration_setups_[j], parent, child, parent_marker, child_marker);  // merge
+							feedCalibrationSetup(calibration_setups_[j], parent_id, child_id, parent_marker, child_marker);  // merge
 							found = true;
 							break;
 						}
@@ -197,14 +321,14 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 						}
 
 						CalibrationSetup setup;
-						setup.origin_ = origin;
+						setup.origin_ = origin_id;
 						getForwardChain(parent_branch_reversed, setup.parent_branch_);
 						getForwardChain(child_branch_reversed, setup.child_branch_);
 
 						if ( setup.parent_branch_.size() == 0 || setup.child_branch_.size() == 0 )
 							ROS_WARN("RobotCalibration::RobotCalibration - Parent- or child-branch is empty. Proceeding...");
 
-						feedCalibrationSetup(setup, parent, child, parent_marker, child_marker);
+						feedCalibrationSetup(setup, parent_id, child_id, parent_marker, child_marker);
 						calibration_setups_.push_back(setup);
 					}
 				}
@@ -231,7 +355,7 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 				if ( calibration_setups_[i].uncertainties_list_[j].parent_markers_.size() == 0 ||
 						calibration_setups_[i].uncertainties_list_[j].child_markers_.size() == 0 )
 				{
-					ROS_WARN("RobotCalibration::RobotCalibration - Empty parent or child_markers for %s to %s -> removing transform", calibration_setups_[i].uncertainties_list_[j].parent_.c_str(), calibration_setups_[i].uncertainties_list_[j].child_.c_str());
+					ROS_WARN("RobotCalibration::RobotCalibration - Empty parent or child_markers for %s to %s -> removing transform", FrameRegistry::name(calibration_setups_[i].uncertainties_list_[j].parent_).c_str(), FrameRegistry::name(calibration_setups_[i].uncertainties_list_[j].child_).c_str());
 					calibration_setups_[i].uncertainties_list_.erase(calibration_setups_[i].uncertainties_list_.begin()+j);
 					--j;
 				}
@@ -284,24 +408,24 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 	for ( int i=0; i<calibration_setups_.size(); ++i )
 	{
 		std::cout << std::endl << "Calibration Setup " << (i+1) << ":" << std::endl;
-		std::cout << "\tOrigin:\t" << calibration_setups_[i].origin_ << std::endl;
+		std::cout << "\tOrigin:\t" << FrameRegistry::name(calibration_setups_[i].origin_) << std::endl;
 
 		std::string branch = "";
 		for ( int j=0; j<calibration_setups_[i].parent_branch_.size(); ++j )  // parent branch
 		{
 			if ( j < calibration_setups_[i].parent_branch_.size()-1 )
-				branch += (calibration_setups_[i].parent_branch_[j] + ";");
+				branch += (FrameRegistry::name(calibration_setups_[i].parent_branch_[j]) + ";");
 			else
-				branch += calibration_setups_[i].parent_branch_[j];
+				branch += FrameRegistry::name(calibration_setups_[i].parent_branch_[j]);
 		}
 		std::cout << "\tParent branch:\t" << branch << std::endl;
 		branch = "";
 		for ( int j=0; j<calibration_setups_[i].child_branch_.size(); ++j )  // child branch
 		{
 			if ( j < calibration_setups_[i].child_branch_.size()-1 )
-				branch += (calibration_setups_[i].child_branch_[j] + ";");
+				branch += (FrameRegistry::name(calibration_setups_[i].child_branch_[j]) + ";");
 			else
-				branch += calibration_setups_[i].child_branch_[j];
+				branch += FrameRegistry::name(calibration_setups_[i].child_branch_[j]);
 		}
 		std::cout << "\tChild branch:\t" << branch << std::endl;
 
@@ -309,7 +433,7 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 		{
 			const CalibrationInfo &uncertainty = calibration_setups_[i].uncertainties_list_[j];
 			std::cout << "\tUncertainty " << (j+1) << ":" << std::endl;
-			std::cout << "\t\tFrom <" << uncertainty.parent_ << "> to <" << uncertainty.child_ << ">" << std::endl;
+			std::cout << "\t\tFrom <" << FrameRegistry::name(uncertainty.parent_) << "> to <" << FrameRegistry::name(uncertainty.child_) << ">" << std::endl;
 
 			std::string parent_markers = "";
 			std::string child_markers = "";
@@ -317,13 +441,13 @@ RobotCalibration::RobotCalibration(ros::NodeHandle nh, CalibrationInterface* int
 			{
 				if ( l < uncertainty.parent_markers_.size()-1 )
 				{
-					parent_markers += (uncertainty.parent_markers_[l] + ";");
-					child_markers += (uncertainty.child_markers_[l] + ";");
+					parent_markers += (FrameRegistry::name(uncertainty.parent_markers_[l]) + ";");
+					child_markers += (FrameRegistry::name(uncertainty.child_markers_[l]) + ";");
 				}
 				else
 				{
-					parent_markers += uncertainty.parent_markers_[l];
-					child_markers += uncertainty.child_markers_[l];
+					parent_markers += FrameRegistry::name(uncertainty.parent_markers_[l]);
+					child_markers += FrameRegistry::name(uncertainty.child_markers_[l]);
 				}
 			}
 			std::cout << "\t\tParent markers:\t" << parent_markers << std::endl;
@@ -351,6 +475,125 @@ RobotCalibration::~RobotCalibration()
 		delete calibration_interface_;
 }
 
+bool RobotCalibration::captureFrameGraph(const std::vector<std::string> &required_frames, const double timeout)
+{
+	const std::string prefix = "Frame ";
+	const std::string separator = " exists with parent ";
+	const double start_time = time_utilities::getSystemTimeSec();
+
+	while ( true )
+	{
+		// one line per frame: "Frame <child> exists with parent <parent>."
+		frame_parents_.clear();
+		std::vector<std::string> parents;
+		std::istringstream dump(transform_listener_.allFramesAsString());
+		std::string line;
+		while ( std::getline(dump, line) )
+		{
+			const size_t pos = line.find(separator);
+			if ( pos == std::string::npos || line.compare(0, prefix.size(), prefix) != 0 )
+				continue;
+
+			std::string parent = line.substr(pos+separator.size());
+			if ( !parent.empty() && parent[parent.size()-1] == '.' )
+				parent.erase(parent.size()-1);
+			if ( parent.compare("NO_PARENT") == 0 )
+				parent.clear();
+
+			frame_parents_[line.substr(prefix.size(), pos-prefix.size())] = parent;
+			parents.push_back(parent);
+		}
+
+		// root frames only show up as parents
+		for ( int i=0; i<parents.size(); ++i )
+		{
+			if ( !parents[i].empty() && frame_parents_.find(parents[i]) == frame_parents_.end() )
+				frame_parents_[parents[i]] = "";
+		}
+
+		// the graph is walked up to its roots in several places, cut every parent chain that runs into a cycle so that these walks terminate
+		for ( std::map<std::string, std::string>::const_iterator it=frame_parents_.begin(); it!=frame_parents_.end(); ++it )
+		{
+			std::set<std::string> chain;
+			std::string frame = it->first;
+			std::string parent = "";
+			chain.insert(frame);
+			while ( getFrameParent(frame, parent) )
+			{
+				if ( !chain.insert(parent).second )
+				{
+					ROS_ERROR("RobotCalibration::captureFrameGraph - tf tree contains a cycle, dropping the link from %s to its parent %s.", frame.c_str(), parent.c_str());
+					frame_parents_[frame] = "";
+					break;
+				}
+				frame = parent;
+			}
+		}
+
+		bool complete = true;
+		for ( int i=0; i<required_frames.size() && complete; ++i )
+			complete = ( frame_parents_.find(required_frames[i]) != frame_parents_.end() );
+
+		if ( complete || time_utilities::getTimeElapsedSec(start_time) >= timeout )
+		{
+			captureFrameTransforms(required_frames);
+			return complete;
+		}
+
+		ros::Duration(0.1).sleep();
+	}
+}
+
+void RobotCalibration::captureFrameTransforms(const std::vector<std::string> &required_frames)
+{
+	// one lookup of all links that end in a required frame, without waiting: the frame graph says they are in tf already
+	std::vector< std::pair<std::string, std::string> > links;
+	std::vector<std::string> children;
+	for ( int i=0; i<required_frames.size(); ++i )
+	{
+		std::string parent = "";
+		if ( std::find(children.begin(), children.end(), required_frames[i]) == children.end() && getFrameParent(required_frames[i], parent) )
+		{
+			links.push_back(std::make_pair(parent, required_frames[i]));
+			children.push_back(required_frames[i]);
+		}
+	}
+
+	frame_transforms_.clear();
+	std::vector<cv::Mat> transforms;
+	ros::Time stamp;
+	transform_utilities::getTransformsAtCommonTime(transform_listener_, links, std::vector<bool>(links.size(), false), 0.0, 0.0, transforms, stamp);
+	for ( int i=0; i<transforms.size(); ++i )
+	{
+		if ( !transforms[i].empty() )
+			frame_transforms_[children[i]] = transforms[i];
+	}
+}
+
+bool RobotCalibration::getFrameParent(const std::string &frame, std::string &parent) const
+{
+	std::map<std::string, std::string>::const_iterator it = frame_parents_.find(frame);
+	if ( it == frame_parents_.end() || it->second.empty() )
+		return false;
+
+	parent = it->second;
+	return true;
+}
+
+bool RobotCalibration::areFramesConnected(const std::string &frame_a, const std::string &frame_b) const
+{
+	if ( frame_parents_.find(frame_a) == frame_parents_.end() || frame_parents_.find(frame_b) == frame_parents_.end() )
+		return false;
+
+	std::string root_a = frame_a;
+	while ( getFrameParent(root_a, root_a) );
+
+	std::string root_b = frame_b;
+	while ( getFrameParent(root_b, root_b) );
+
+	return ( root_a.compare(root_b) == 0 );
+}
+
 bool RobotCalibration::getOrigin(const std::string last_parent_branch_frame, const std::string last_child_branch_frame, std::string &origin)
 {
 	if ( last_parent_branch_frame.empty() || last_child_branch_frame.empty() )
@@ -366,7 +609,7 @@ bool RobotCalibration::getOrigin(const std::string last_parent_branch_frame, con
 	{
 		parent_frames.push_back(frame);  // populate backwards chain
 	}
-	while ( transform_listener_.getParent(frame, ros::Time(0), frame) );
+	while ( getFrameParent(frame, frame) );
 
 	// check for occurrence of first frame of child-branch in parent-branch
 	frame = last_child_branch_frame;
@@ -381,27 +624,27 @@ bool RobotCalibration::getOrigin(const std::string last_parent_branch_frame, con
 			}
 		}
 	}
-	while ( transform_listener_.getParent(frame, ros::Time(0), frame) );  // go back from last_child_branch_frame on and see where it meets with parent_frames
+	while ( getFrameParent(frame, frame) );  // go back from last_child_branch_frame on and see where it meets with parent_frames
 
 	ROS_WARN("RobotCalibration::getOrigin - No mutual origin found between %s and %s.", last_parent_branch_frame.c_str(), last_child_branch_frame.c_str());
 	return false;
 }
 
-bool RobotCalibration::isPartOfCalibrationSetup(const std::string parent, const std::string child, const std::string origin, const CalibrationSetup &setup)
+bool RobotCalibration::isPartOfCalibrationSetup(const FrameId parent, const FrameId child, const FrameId origin, const CalibrationSetup &setup)
 {
-	if ( origin.compare(setup.origin_) == 0 )
+	if ( origin == setup.origin_ )
 	{
-		for ( int i=0; i<setup.parent_branch_.size()-1; i++ )
+		for ( int i=0; i+1<setup.parent_branch_.size(); i++ )
 		{
-			if ( parent.compare(setup.parent_branch_[i]) == 0 && child.compare(setup.parent_branch_[i+1]) == 0 )
+			if ( parent == setup.parent_branch_[i] && child == setup.parent_branch_[i+1] )
 			{
 				return true;
 			}
 		}
 
-		for ( int i=0; i<setup.child_branch_.size()-1; i++ )
+		for ( int i=0; i+1<setup.child_branch_.size(); i++ )
 		{
-			if ( parent.compare(setup.child_branch_[i]) == 0 && child.compare(setup.child_branch_[i+1]) == 0 )
+			if ( parent == setup.child_branch_[i] && child == setup.child_branch_[i+1] )
 			{
 				return true;
 			}
@@ -411,19 +654,19 @@ bool RobotCalibration::isPartOfCalibrationSetup(const std::string parent, const
 	return false;
 }
 
-void RobotCalibration::feedCalibrationSetup(CalibrationSetup &setup, const std::string parent, const std::string child,
-		const std::string parent_marker, const std::string child_marker)
+void RobotCalibration::feedCalibrationSetup(CalibrationSetup &setup, const FrameId parent, const FrameId child,
+		const FrameId parent_marker, const FrameId child_marker)
 {
 	// first check if transform already exists, if so extend it
 	for ( int i=0; i<setup.uncertainties_list_.size(); ++i )
 	{
-		if ( setup.uncertainties_list_[i].parent_.compare(parent) == 0 &&
-				setup.uncertainties_list_[i].child_.compare(child) == 0 )  // transform already exists, check if we have to extend its marker frames
+		if ( setup.uncertainties_list_[i].parent_ == parent &&
+				setup.uncertainties_list_[i].child_ == child )  // transform already exists, check if we have to extend its marker frames
 		{
 			for ( int j=0; j<setup.uncertainties_list_[i].parent_markers_.size(); ++j )  // parent_markers and child_markers always have same size
 			{
-				if ( setup.uncertainties_list_[i].parent_markers_[j].compare(parent_marker) == 0 &&
-						setup.uncertainties_list_[i].child_markers_[j].compare(child_marker) == 0 )  // marker frames already exist -> nothing to do here anymore
+				if ( setup.uncertainties_list_[i].parent_markers_[j] == parent_marker &&
+						setup.uncertainties_list_[i].child_markers_[j] == child_marker )  // marker frames already exist -> nothing to do here anymore
 				{
 					ROS_WARN("RobotCalibration::feedCalibrationSetup - There are redundant entries within the uncertainties list." );
 					return;
@@ -439,10 +682,12 @@ void RobotCalibration::feedCalibrationSetup(CalibrationSetup &setup, const std::
 
 	// add new transform to be calibrated
 	CalibrationInfo info;
-	bool success = transform_utilities::getTransform(transform_listener_, parent, child, info.current_trafo_);  // init uncertain trafo with what's in tf
+	// init uncertain trafo with what's in tf, the uncertainty is a link of the frame graph, i.e. parent is the parent of child
+	std::map<std::string, cv::Mat>::const_iterator it = frame_transforms_.find(FrameRegistry::name(child));
 
-	if ( success )
+	if ( it != frame_transforms_.end() )
 	{
+		info.current_trafo_ = it->second.clone();
 		info.parent_ = parent;
 		info.child_ = child;
 		info.calibrated_ = false;
@@ -451,7 +696,7 @@ void RobotCalibration::feedCalibrationSetup(CalibrationSetup &setup, const std::
 		setup.uncertainties_list_.push_back(info);
 	}
 	else
-		ROS_WARN("RobotCalibration::feedCalibrationSetup - Unable to get transform from %s to %s, skipping uncertainty.", parent.c_str(), child.c_str());
+		ROS_WARN("RobotCalibration::feedCalibrationSetup - Unable to get transform from %s to %s, skipping uncertainty.", FrameRegistry::name(parent).c_str(), FrameRegistry::name(child).c_str());
 }
 
 bool RobotCalibration::getBackChain(const std::string frame_start, const std::string frame_end, std::vector<std::string> &backchain)
@@ -464,7 +709,7 @@ bool RobotCalibration::getBackChain(const std::string frame_start, const std::st
 		{
 			backchain.push_back(frame);  // populate backwards chain
 
-			if ( !transform_listener_.getParent(frame, ros::Time(0), frame) )
+			if ( !getFrameParent(frame, frame) )
 			{
 				ROS_WARN("RobotCalibration::getBackChain - Could not create back chain for frame %s, no parent frame for %s!", frame_start.c_str(), frame.c_str());
 				backchain.clear();
@@ -479,26 +724,26 @@ bool RobotCalibration::getBackChain(const std::string frame_start, const std::st
 	return true;
 }
 
-void RobotCalibration::getForwardChain(const std::vector<std::string> &backchain, std::vector<std::string> &forwardchain)
+void RobotCalibration::getForwardChain(const std::vector<std::string> &backchain, std::vector<FrameId> &forwardchain)
 {
 	if ( !forwardchain.empty() )
 		forwardchain.clear();
 
 	forwardchain.reserve(backchain.size());
 	for ( int i=backchain.size()-1; i>=0; --i )
-		forwardchain.push_back(backchain[i]);
+		forwardchain.push_back(FrameRegistry::intern(backchain[i]));
 }
 
 void RobotCalibration::sortUncertainties(const bool parent_branch, CalibrationSetup &setup, std::vector<CalibrationInfo> &sorted_uncertainties)
 {
-	std::vector<std::string> &branch = (parent_branch ? setup.parent_branch_ : setup.child_branch_);
+	std::vector<FrameId> &branch = (parent_branch ? setup.parent_branch_ : setup.child_branch_);
 
-	for ( int i=0; i<branch.size()-1; ++i )
+	for ( int i=0; i+1<branch.size(); ++i )
 	{
 		for ( int k=0; k<setup.uncertainties_list_.size(); ++k )
 		{
-			if ( branch[i].compare(setup.uncertainties_list_[k].parent_) == 0 &&
-					branch[i+1].compare(setup.uncertainties_list_[k].child_) == 0 )
+			if ( branch[i] == setup.uncertainties_list_[k].parent_ &&
+					branch[i+1] == setup.uncertainties_list_[k].child_ )
 			{
 				CalibrationInfo &info = setup.uncertainties_list_[k];
 
@@ -517,17 +762,17 @@ void RobotCalibration::sortUncertainties(const bool parent_branch, CalibrationSe
 	}
 }
 
-void RobotCalibration::truncateBranch(std::vector<std::string> &branch, std::vector<CalibrationInfo> &branch_uncertainties)
+void RobotCalibration::truncateBranch(std::vector<FrameId> &branch, std::vector<CalibrationInfo> &branch_uncertainties)
 {
 	if ( branch.size() == 0 )
 		return;
 
 	// take child frame of last uncertainty on respective branch or origin (and remove branch completely in this case)
-	std::string last_uncertainty_child = (branch_uncertainties.size() > 0) ? branch_uncertainties[branch_uncertainties.size()-1].child_ : branch[0];
+	const FrameId last_uncertainty_child = (branch_uncertainties.size() > 0) ? branch_uncertainties[branch_uncertainties.size()-1].child_ : branch[0];
 
-	for ( int i=0; i<branch.size()-1; ++i )
+	for ( int i=0; i+1<branch.size(); ++i )
 	{
-		if ( branch[i].compare(last_uncertainty_child) == 0 )
+		if ( branch[i] == last_uncertainty_child )
 		{
 			branch.erase(branch.begin()+i+1, branch.end());  // erase everything that comes after last uncertainty child
 			break;
@@ -550,30 +795,40 @@ bool RobotCalibration::startCalibration()
 	if ( !acquireTFData() )  // make snapshots of all relevant tf transforms for every robot configuration
 		return false;
 
-	// extrinsic calibration optimization
-	for ( int l=0; l<calibration_setups_.size(); ++l )
+	// flatten snapshots once, so that the optimization does not need to deal with frame names or cv::Mat objects
+	if ( !compiled_snapshots_.compile(calibration_setups_, tf_snapshots_, calibration_interface_) )
 	{
-		int iterations = 0;
+		ROS_ERROR("RobotCalibration::startCalibration - Could not prepare snapshots for calibration!");
+		return false;
+	}
 
-		// if there is only one trafo to calibrate, we don't need to optimize over iterations
-		if ( calibration_setups_[l].uncertainties_list_.size() > 1 )
-			iterations = optimization_iterations_;
-		else
-			iterations = 1;
+	optimization_iteration_counts_.assign(calibration_setups_.size(), 0);
+	residual_histories_.assign(calibration_setups_.size(), std::vector<double>());
+	configuration_inliers_.assign(calibration_setups_.size(), std::vector<bool>());
 
-		for (int i=0; i<iterations; ++i)
-		{
-			for ( int j=0; j<calibration_setups_[l].uncertainties_list_.size(); ++j )
-			{
-				if ( !ros::ok() || !extrinsicCalibration(l, j) )
-				{
-					ROS_ERROR("RobotCalibration::startCalibration - Calibration has failed!");
-					return false;
-				}
-			}
-		}
+	// extrinsic calibration optimization, setups that do not share uncertainties are solved concurrently
+	compiled_snapshots_.getIndependentSetupGroups(optimization_groups_);
+	next_optimization_group_ = 0;
+	optimization_failed_ = false;
+
+	const int num_threads = std::max(1, std::min(optimization_threads_, (int)optimization_groups_.size()));
+	if ( num_threads > 1 )
+	{
+		boost::thread_group workers;
+		for ( int i=0; i<num_threads; ++i )
+			workers.create_thread(boost::bind(&RobotCalibration::optimizationWorker, this));
+		workers.join_all();
+	}
+	else
+		optimizationWorker();
+
+	if ( optimization_failed_ )
+	{
+		ROS_ERROR("RobotCalibration::startCalibration - Calibration has failed!");
+		return false;
 	}
 
+	compiled_snapshots_.exportUncertainties(calibration_setups_);
 	RobotCalibration::displayAndSaveCalibrationResult();
 	calibrated_ = true;
 	return true;
@@ -584,62 +839,170 @@ bool RobotCalibration::acquireTFData()
 	if ( !load_data_from_disk_ )
 	{
 		const int num_configs = calibration_interface_->getConfigurationCount();
-		for ( int config_counter = 0; config_counter < num_configs; ++config_counter )
+		const std::string journal_file_path = calibration_storage_path_+calib_data_folder_+"/"+calib_journal_file_name_;
+		std::vector<bool> visited(num_configs, false);
+		snapshot_configs_.clear();
+
+		// the journal stores the configurations the robot has actually been moved to, as the visiting order may differ between runs
+		std::vector<int> journal_to_config(num_configs, -1);
+		for ( int i=0; i<num_configs; ++i )
+		{
+			const int scheduled_index = calibration_interface_->getScheduledIndex(i);
+			if ( scheduled_index >= 0 && scheduled_index < num_configs )
+				journal_to_config[scheduled_index] = i;
+		}
+
+		// continue an interrupted acquisition: configurations already in the journal are neither driven to nor captured again
+		if ( resume_acquisition_ )
+		{
+			std::vector<int> journal_indices;
+			std::vector< std::vector<TFSnapshot> > journal_snapshots;
+			if ( snapshot_store::loadJournal(journal_file_path, journal_indices, journal_snapshots) )
+			{
+				for ( int i=0; i<journal_indices.size(); ++i )
+				{
+					if ( journal_indices[i] < 0 || journal_indices[i] >= num_configs || journal_to_config[journal_indices[i]] < 0 )
+						continue;
+
+					const int config_index = journal_to_config[journal_indices[i]];
+					visited[config_index] = true;
+					if ( journal_snapshots[i].size() == calibration_setups_.size() )
+					{
+						tf_snapshots_.push_back(journal_snapshots[i]);
+						snapshot_configs_.push_back(config_index);
+					}
+					else if ( !journal_snapshots[i].empty() )
+						ROS_WARN("RobotCalibration::acquireTFData - Journal entry of configuration %d does not match calibration setups, skipping it.", journal_indices[i]+1);
+				}
+				std::cout << "Resuming acquisition: " << std::count(visited.begin(), visited.end(), true) << " configurations already visited, "
+						  << tf_snapshots_.size() << " snapshots restored." << std::endl;
+			}
+			else
+				ROS_WARN("RobotCalibration::acquireTFData - No journal found at %s, starting from the first configuration.", journal_file_path.c_str());
+		}
+
+		FramePairList frame_pairs;
+		collectFramePairs(frame_pairs);
+
+		// the robot and the marker detections have settled at the latest after the interface's settle time (plus one second for tf to update)
+		const double max_settle_time = 1.0 + calibration_interface_->getMaxSettleTime();
+
+		snapshot_store::SnapshotJournal journal;
+		if ( !journal.open(journal_file_path, resume_acquisition_) )
+			ROS_WARN("RobotCalibration::acquireTFData - Could not open snapshot journal, acquisition can not be resumed after a crash.");
+
+		ConfigurationSelector selector;
+		if ( active_sampling_ )
+		{
+			std::vector< std::vector<double> > parameters(num_configs);
+			for ( int i=0; i<num_configs; ++i )
+				calibration_interface_->getConfigurationParameters(i, parameters[i]);
+
+			selector.initialize(parameters, active_initial_configurations_, active_translation_precision_, active_rotation_precision_);
+			for ( int i=0; i<num_configs; ++i )
+			{
+				if ( visited[i] )
+					selector.markVisited(i);
+			}
+
+			for ( int k=0; k<tf_snapshots_.size(); ++k )  // snapshots restored from the journal
+				selector.update(calibration_setups_, tf_snapshots_[k], snapshot_configs_[k], calibration_interface_);
+		}
+
+		int next_config = 0;
+		int current_config = -1;  // configuration the robot has last been moved to, unknown at the start
+		while ( true )
 		{
 			if ( !ros::ok() )
 				return false;
 
+			// pick next configuration, either by expected information gain or one after another
+			int config_counter = -1;
+			if ( active_sampling_ )
+			{
+				if ( selector.isPrecisionReached() )
+				{
+					std::cout << std::endl << "Target precision reached after " << std::count(visited.begin(), visited.end(), true) << " of " << num_configs << " configurations." << std::endl;
+					break;
+				}
+				config_counter = selector.selectNext(current_config, calibration_interface_);
+			}
+			else
+			{
+				while ( next_config < num_configs && visited[next_config] )
+					++next_config;
+				if ( next_config < num_configs )
+					config_counter = next_config;
+			}
+
+			if ( config_counter < 0 )
+				break;
+
+			visited[config_counter] = true;
+			if ( active_sampling_ )
+				selector.markVisited(config_counter);
+
 			std::cout << std::endl << "Configuration " << (config_counter+1) << "/" << num_configs << std::endl;
+			const int journal_index = calibration_interface_->getScheduledIndex(config_counter);
 
 			// try to move robot
 			try
 			{
 				if ( !calibration_interface_->moveRobot(config_counter) )
+				{
+					journal.append(journal_index, std::vector<TFSnapshot>());  // unreachable, don't try again on resume
 					continue;
+				}
+				current_config = config_counter;
 			}
 			catch( std::exception &ex )
 			{
 				return false;
 			}
 
-			// wait a moment here to mitigate shaking camera effects and give tf time to update
-			ros::Duration(1).sleep();
+			// wait until shaking camera effects have decayed and the markers are detected steadily
+			if ( settle_detection_ )
+				waitForSettle(frame_pairs, max_settle_time);
+			else
+				ros::Duration(max_settle_time).sleep();
 			calibration_interface_->preSnapshot(config_counter);  // give user possibility to execute code before snapshots take place
 			std::cout << "Populating snapshots..." << std::endl;
 
-			// grab transforms for each setup and store them
+			// grab transforms for all setups at once and store them
 			std::vector<TFSnapshot> snapshots;
-			snapshots.reserve(calibration_setups_.size());
-			bool skip_configuration = false;
-			for ( int i=0; i<calibration_setups_.size(); ++i )
-			{
-				TFSnapshot snapshot;
-				populateTFSnapshot(calibration_setups_[i], snapshot);
+			const bool skip_configuration = !populateTFSnapshots(frame_pairs, snapshots);
 
-				if ( !ros::ok() || !snapshot.valid_ )
-				{
-					skip_configuration = true;
-					break;
-				}
-				else
-					snapshots.push_back(snapshot);
-			}
+			if ( !ros::ok() )  // interrupted while capturing, retry this configuration on resume
+				return false;
 
 			if ( !skip_configuration )
 			{
 				tf_snapshots_.push_back(snapshots);
+				snapshot_configs_.push_back(config_counter);
+				journal.append(journal_index, snapshots);
+
+				if ( active_sampling_ )
+					selector.update(calibration_setups_, snapshots, config_counter, calibration_interface_);
 			}
+			else
+				journal.append(journal_index, std::vector<TFSnapshot>());
 		}
 
 		// save calibration setups and snapshots to disk for offline calibration
 		std::cout << std::endl << "Saving offline data to disk..." << std::endl << std::endl;
 		file_utilities::saveCalibrationSetups(calibration_setups_, (calibration_storage_path_+calib_data_folder_), calib_data_file_name_);
-		file_utilities::saveSnapshots(tf_snapshots_, (calibration_storage_path_+calib_data_folder_), calib_data_file_name_);
+		snapshot_store::saveSnapshots(tf_snapshots_, (calibration_storage_path_+calib_data_folder_+"/"+calib_snapshot_file_name_));
 	}
 	else
 	{
 		std::cout << std::endl << "Loading snapshots from disk..." << std::endl << std::endl;
-		bool result = file_utilities::loadSnapshots(tf_snapshots_, (calibration_storage_path_+calib_data_folder_), calib_data_file_name_);
+		const std::string snapshot_file_path = calibration_storage_path_+calib_data_folder_+"/"+calib_snapshot_file_name_;
+		bool result = false;
+
+		if ( boost::filesystem::exists(snapshot_file_path) )
+			result = snapshot_store::loadSnapshots(tf_snapshots_, snapshot_file_path);
+		else  // data recorded before the binary snapshot store existed
+			result = file_utilities::loadSnapshots(tf_snapshots_, (calibration_storage_path_+calib_data_folder_), calib_data_file_name_);
 
 		if ( !result )
 			return false;
@@ -648,99 +1011,250 @@ bool RobotCalibration::acquireTFData()
 	return true;
 }
 
-void RobotCalibration::populateTFSnapshot(const CalibrationSetup &setup, TFSnapshot &snapshot)
+void RobotCalibration::getBranchEndFrames(const CalibrationSetup &setup, const int uncertainty_idx, FrameId &last_branch_frame, FrameId &last_otherbranch_frame)
 {
-	// populate parent branch trafos
-	snapshot.valid_ = false;
-	for ( int i=0; i<setup.parent_branch_.size()-1; ++i )
+	// depending on which branch uncertainty lies, end frames are different
+	const FrameId last_parent_branch_frame = (setup.parent_branch_.size() > 0) ? setup.parent_branch_[setup.parent_branch_.size()-1] : setup.origin_;
+	const FrameId last_child_branch_frame = (setup.child_branch_.size() > 0) ? setup.child_branch_[setup.child_branch_.size()-1] : setup.origin_;
+
+	if ( setup.uncertainties_list_[uncertainty_idx].parent_branch_uncertainty_ )
 	{
-		cv::Mat trafo;
-		if ( transform_utilities::getTransform(transform_listener_, setup.parent_branch_[i], setup.parent_branch_[i+1], trafo, transform_discard_timeout_, true) )
-		{
-			TFInfo info;
-			info.parent_ = setup.parent_branch_[i];
-			info.child_ = setup.parent_branch_[i+1];
-			info.transform_ = trafo.clone();
-			snapshot.parent_branch_.push_back(info);
-		}
-		else
+		last_branch_frame = last_parent_branch_frame;
+		last_otherbranch_frame = last_child_branch_frame;
+	}
+	else
+	{
+		last_branch_frame = last_child_branch_frame;
+		last_otherbranch_frame = last_parent_branch_frame;
+	}
+}
+
+int RobotCalibration::addFramePair(const FrameId parent, const FrameId child, const bool required, FramePairList &frame_pairs)
+{
+	const std::pair<FrameId, FrameId> frame_pair(parent, child);
+	std::map<std::pair<FrameId, FrameId>, int>::const_iterator it = frame_pairs.index_.find(frame_pair);
+	if ( it != frame_pairs.index_.end() )
+	{
+		if ( required )
+			frame_pairs.required_[it->second] = true;
+		return it->second;
+	}
+
+	const int idx = frame_pairs.frames_.size();
+	frame_pairs.index_[frame_pair] = idx;
+	frame_pairs.frames_.push_back(std::make_pair(FrameRegistry::name(parent), FrameRegistry::name(child)));
+	frame_pairs.required_.push_back(required);
+	return idx;
+}
+
+void RobotCalibration::collectFramePairs(FramePairList &frame_pairs)
+{
+	frame_pairs = FramePairList();
+
+	// gather every transform any calibration setup needs, branch links are required, markers may be missing
+	for ( int l=0; l<calibration_setups_.size(); ++l )
+	{
+		const CalibrationSetup &setup = calibration_setups_[l];
+		for ( int i=0; i+1<setup.parent_branch_.size(); ++i )
+			addFramePair(setup.parent_branch_[i], setup.parent_branch_[i+1], true, frame_pairs);
+		for ( int i=0; i+1<setup.child_branch_.size(); ++i )
+			addFramePair(setup.child_branch_[i], setup.child_branch_[i+1], true, frame_pairs);
+
+		for ( int i=0; i<setup.uncertainties_list_.size(); ++i )
 		{
-			ROS_ERROR("RobotCalibration::populateTFSnapshot - Could not build parent branch, skipping to snapshot current configuration!");
-			return;
+			FrameId last_branch_frame, last_otherbranch_frame;
+			getBranchEndFrames(setup, i, last_branch_frame, last_otherbranch_frame);
+
+			for ( int j=0; j<setup.uncertainties_list_[i].parent_markers_.size(); ++j )
+				addFramePair(last_otherbranch_frame, setup.uncertainties_list_[i].parent_markers_[j], false, frame_pairs);
+			for ( int j=0; j<setup.uncertainties_list_[i].child_markers_.size(); ++j )
+				addFramePair(last_branch_frame, setup.uncertainties_list_[i].child_markers_[j], false, frame_pairs);
 		}
 	}
+}
 
-	// populate child branch trafos
-	for ( int i=0; i<setup.child_branch_.size()-1; ++i )
+bool RobotCalibration::waitForSettle(const FramePairList &frame_pairs, const double max_wait)
+{
+	const double start_time = time_utilities::getSystemTimeSec();
+	std::deque< std::vector<cv::Mat> > window;  // tf samples of the last settle_window_ seconds
+	std::deque<ros::Time> window_stamps;
+	std::vector<cv::Mat> transforms, samples;
+	ros::Time stamp;
+	cv::Mat mean;
+
+	while ( ros::ok() && time_utilities::getTimeElapsedSec(start_time) < max_wait )
 	{
-		cv::Mat trafo;
-		if ( transform_utilities::getTransform(transform_listener_, setup.child_branch_[i], setup.child_branch_[i+1], trafo, transform_discard_timeout_, true) )
+		ros::Duration(0.05).sleep();
+
+		if ( !transform_utilities::getTransformsAtCommonTime(transform_listener_, frame_pairs.frames_, frame_pairs.required_, transform_discard_timeout_, 0.0, transforms, stamp) )
 		{
-			TFInfo info;
-			info.parent_ = setup.child_branch_[i];
-			info.child_ = setup.child_branch_[i+1];
-			info.transform_ = trafo.clone();
-			snapshot.child_branch_.push_back(info);
+			window.clear();
+			window_stamps.clear();
+			continue;
 		}
-		else
+
+		if ( !window_stamps.empty() && stamp == window_stamps.back() )  // no new tf data
+			continue;
+
+		window.push_back(transforms);
+		window_stamps.push_back(stamp);
+		while ( window_stamps.size() > 1 && (stamp - window_stamps[1]).toSec() >= settle_window_ )
 		{
-			ROS_ERROR("RobotCalibration::populateTFSnapshot - Could not build parent branch, skipping to snapshot current configuration!");
-			return;
+			window.pop_front();
+			window_stamps.pop_front();
+		}
+
+		if ( (stamp - window_stamps.front()).toSec() < settle_window_ )
+			continue;
+
+		// settled if every transform seen now has been seen throughout the window without moving, and at least one marker is among them
+		bool settled = true;
+		int stable_markers = 0;
+		for ( int i=0; i<frame_pairs.frames_.size() && settled; ++i )
+		{
+			if ( transforms[i].empty() )
+				continue;
+
+			samples.clear();
+			for ( int k=0; k<window.size() && settled; ++k )
+			{
+				settled = !window[k][i].empty();
+				samples.push_back(window[k][i]);
+			}
+
+			double translation_variance = 0.0, rotation_variance = 0.0;
+			if ( settled && transform_utilities::averageTransforms(samples, mean, translation_variance, rotation_variance) )
+				settled = ( translation_variance <= settle_translation_threshold_*settle_translation_threshold_ &&
+							rotation_variance <= settle_rotation_threshold_*settle_rotation_threshold_ );
+
+			if ( settled && !frame_pairs.required_[i] )
+				++stable_markers;
+		}
+
+		if ( settled && stable_markers > 0 )
+		{
+			std::cout << "Settled after " << time_utilities::getTimeElapsedSec(start_time) << " s." << std::endl;
+			return true;
 		}
 	}
 
-	// populate trafos to parent and child markers for each uncertainty
-	for ( int i=0; i<setup.uncertainties_list_.size(); ++i )
+	if ( ros::ok() )
+		std::cout << "Markers did not settle within " << max_wait << " s, snapshotting anyway." << std::endl;
+	return false;
+}
+
+bool RobotCalibration::populateTFSnapshots(const FramePairList &frame_pairs, std::vector<TFSnapshot> &snapshots)
+{
+	snapshots.clear();
+
+	// all transforms of one sample are taken from the same instant, samples with a stamp that has already been seen carry no new data
+	std::vector< std::vector<cv::Mat> > samples(frame_pairs.frames_.size());
+	std::vector<cv::Mat> transforms;
+	ros::Time stamp, last_stamp;
+	int sample_count = 0;
+	for ( int s=0; s<tf_samples_ && ros::ok(); ++s )
 	{
-		std::string last_branch_frame;  // child markers are always on the branch on which uncertainty is as well
-		std::string last_otherbranch_frame;  // parent markers are always on other branch
+		if ( s > 0 )
+			ros::Duration(tf_sample_interval_).sleep();
 
-		// depending on which branch uncertainty lies, end frames are different
-		if ( setup.uncertainties_list_[i].parent_branch_uncertainty_ )
+		if ( !transform_utilities::getTransformsAtCommonTime(transform_listener_, frame_pairs.frames_, frame_pairs.required_, transform_discard_timeout_, tf_max_wait_, transforms, stamp) )
 		{
-			last_branch_frame = (setup.parent_branch_.size() > 0) ? setup.parent_branch_[setup.parent_branch_.size()-1] : setup.origin_;
-			last_otherbranch_frame = (setup.child_branch_.size() > 0) ? setup.child_branch_[setup.child_branch_.size()-1] : setup.origin_;
+			ROS_ERROR("RobotCalibration::populateTFSnapshots - Could not build branches, skipping to snapshot current configuration!");
+			return false;
 		}
-		else
+
+		if ( sample_count > 0 && stamp == last_stamp )
+			continue;
+
+		last_stamp = stamp;
+		++sample_count;
+		for ( int i=0; i<transforms.size(); ++i )
+			if ( !transforms[i].empty() )
+				samples[i].push_back(transforms[i]);
+	}
+
+	if ( sample_count == 0 )
+		return false;
+
+	if ( tf_samples_ > 1 )
+		std::cout << "Fused " << sample_count << " tf samples." << std::endl;
+
+	// fuse the samples of each transform, markers that have not been seen in any sample stay empty. markers seen in too few of
+	// several samples are dropped as well, their spread is unknown and they would otherwise get the largest weight
+	std::vector<TFInfo> fused(frame_pairs.frames_.size());
+	for ( int i=0; i<fused.size(); ++i )
+	{
+		fused[i].parent_ = FrameRegistry::find(frame_pairs.frames_[i].first);
+		fused[i].child_ = FrameRegistry::find(frame_pairs.frames_[i].second);
+		if ( sample_count > 1 && !frame_pairs.required_[i] && (samples[i].size() < 2 || 2*samples[i].size() < sample_count) )
+			continue;
+
+		if ( samples[i].size() == 1 )
+			fused[i].transform_ = samples[i][0];
+		else if ( samples[i].size() > 1 )
+			transform_utilities::averageTransforms(samples[i], fused[i].transform_, fused[i].translation_variance_, fused[i].rotation_variance_);
+	}
+
+	snapshots.resize(calibration_setups_.size());
+	for ( int l=0; l<calibration_setups_.size(); ++l )
+	{
+		populateTFSnapshot(calibration_setups_[l], frame_pairs, fused, snapshots[l]);
+		if ( !snapshots[l].valid_ )
+			return false;
+	}
+
+	return true;
+}
+
+void RobotCalibration::populateTFSnapshot(const CalibrationSetup &setup, const FramePairList &frame_pairs, const std::vector<TFInfo> &fused, TFSnapshot &snapshot)
+{
+	snapshot.valid_ = false;
+
+	// populate parent and child branch trafos
+	for ( int b=0; b<2; ++b )
+	{
+		const std::vector<FrameId> &branch = ( b == 0 ? setup.parent_branch_ : setup.child_branch_ );
+		std::vector<TFInfo> &branch_infos = ( b == 0 ? snapshot.parent_branch_ : snapshot.child_branch_ );
+		for ( int i=0; i+1<branch.size(); ++i )
 		{
-			last_branch_frame = (setup.child_branch_.size() > 0) ? setup.child_branch_[setup.child_branch_.size()-1] : setup.origin_;
-			last_otherbranch_frame = (setup.parent_branch_.size() > 0) ? setup.parent_branch_[setup.parent_branch_.size()-1] : setup.origin_;
+			TFInfo info;
+			if ( !lookupFramePair(branch[i], branch[i+1], frame_pairs, fused, info) )
+			{
+				ROS_ERROR("RobotCalibration::populateTFSnapshot - Could not build %s branch, skipping to snapshot current configuration!", (b == 0 ? "parent" : "child"));
+				return;
+			}
+			branch_infos.push_back(info);
 		}
+	}
+
+	// populate trafos to parent and child markers for each uncertainty
+	for ( int i=0; i<setup.uncertainties_list_.size(); ++i )
+	{
+		FrameId last_branch_frame;  // child markers are always on the branch on which uncertainty is as well
+		FrameId last_otherbranch_frame;  // parent markers are always on other branch
+		getBranchEndFrames(setup, i, last_branch_frame, last_otherbranch_frame);
 
 		TFBranchEndsToMarkers branch_ends_to_markers;
 		branch_ends_to_markers.corresponding_uncertainty_idx_ = i;
 		std::vector<TFInfo> &to_parent_markers = branch_ends_to_markers.otherbranch_to_parent_markers_;
-		for ( std::string parent_marker : setup.uncertainties_list_[i].parent_markers_ )
+		for ( FrameId parent_marker : setup.uncertainties_list_[i].parent_markers_ )
 		{
-			cv::Mat trafo;
 			TFInfo info;
-			if ( transform_utilities::getTransform(transform_listener_, last_otherbranch_frame, parent_marker, trafo, transform_discard_timeout_, false) )
-			{
-				info.parent_ = last_otherbranch_frame;
-				info.child_ = parent_marker;
-				info.transform_ = trafo.clone();
-			}
+			lookupFramePair(last_otherbranch_frame, parent_marker, frame_pairs, fused, info);
 
 			// Even store info if it is empty (e.g. due to timeout), so to_parent_markers size has the same as setup.parent_branch_uncertainties_[i].parent_markers_
 			to_parent_markers.push_back(info);
 		}
 
 		std::vector<TFInfo> &to_child_markers = branch_ends_to_markers.branch_to_child_markers_;
-		for ( std::string child_marker : setup.uncertainties_list_[i].child_markers_ )
+		for ( FrameId child_marker : setup.uncertainties_list_[i].child_markers_ )
 		{
-			cv::Mat trafo;
 			TFInfo info;
-			if ( transform_utilities::getTransform(transform_listener_, last_branch_frame, child_marker, trafo, transform_discard_timeout_, false) )
-			{
-				info.parent_ = last_branch_frame;
-				info.child_ = child_marker;
-				info.transform_ = trafo.clone();
-			}
+			lookupFramePair(last_branch_frame, child_marker, frame_pairs, fused, info);
 
 			// Also store empty info so that to_child_markers and to_parent_markers have same size, this way we can filter out bad entries easily later on
 			to_child_markers.push_back(info);
 		}
-
 		if ( to_parent_markers.size() != to_child_markers.size() )
 		{
 			ROS_ERROR("RobotCalibration::populateTFSnapshot - to_parent_markers vector has not same size as to_child_markers vector, skipping to snapshot current configuration!");
@@ -761,7 +1275,7 @@ void RobotCalibration::populateTFSnapshot(const CalibrationSetup &setup, TFSnaps
 		if ( to_parent_markers.size() > 0 )  // if to_parent_markers == 0 then to_child_markers == 0
 		{
 			snapshot.branch_ends_to_markers_.push_back(branch_ends_to_markers);
-			std::cout << "Markers found for <" << setup.uncertainties_list_[i].parent_ << "> to <" << setup.uncertainties_list_[i].child_ << ">: " << to_parent_markers.size() << std::endl;
+			std::cout << "Markers found for <" << FrameRegistry::name(setup.uncertainties_list_[i].parent_) << "> to <" << FrameRegistry::name(setup.uncertainties_list_[i].child_) << ">: " << to_parent_markers.size() << std::endl;
 		}
 		else
 		{
@@ -773,6 +1287,17 @@ void RobotCalibration::populateTFSnapshot(const CalibrationSetup &setup, TFSnaps
 	snapshot.valid_ = true;
 }
 
+bool RobotCalibration::lookupFramePair(const FrameId parent, const FrameId child, const FramePairList &frame_pairs, const std::vector<TFInfo> &fused, TFInfo &info)
+{
+	std::map<std::pair<FrameId, FrameId>, int>::const_iterator it = frame_pairs.index_.find(std::make_pair(parent, child));
+	if ( it == frame_pairs.index_.end() || fused[it->second].transform_.empty() )
+		return false;
+
+	info = fused[it->second];
+	info.transform_ = info.transform_.clone();  // each snapshot owns its data
+	return true;
+}
+
 void RobotCalibration::displayAndSaveCalibrationResult()
 {
 	// display and save calibration parameters
@@ -794,16 +1319,38 @@ void RobotCalibration::displayAndSaveCalibrationResult()
 		for ( int j=0; j<calibration_setups_[i].uncertainties_list_.size(); ++j )
 		{
 			cv::Vec3d ypr = transform_utilities::YPRFromRotationMatrix(calibration_setups_[i].uncertainties_list_[j].current_trafo_);
-
-			output << "<!-- " << calibration_setups_[i].uncertainties_list_[j].child_ << " mount positions | camera_base_calibration | relative to " << calibration_setups_[i].uncertainties_list_[j].parent_ << "-->" << std::endl
-				   << "  <property name=\"" << calibration_setups_[i].uncertainties_list_[j].child_ << "_x\" value=\"" << calibration_setups_[i].uncertainties_list_[j].current_trafo_.at<double>(0,3) << "\"/>" << std::endl
-				   << "  <property name=\"" << calibration_setups_[i].uncertainties_list_[j].child_ << "_y\" value=\"" << calibration_setups_[i].uncertainties_list_[j].current_trafo_.at<double>(1,3) << "\"/>" << std::endl
-				   << "  <property name=\"" << calibration_setups_[i].uncertainties_list_[j].child_ << "_z\" value=\"" << calibration_setups_[i].uncertainties_list_[j].current_trafo_.at<double>(2,3) << "\"/>" << std::endl
-				   << "  <property name=\"" << calibration_setups_[i].uncertainties_list_[j].child_ << "_roll\" value=\"" << ypr.val[2] << "\"/>" << std::endl
-				   << "  <property name=\"" << calibration_setups_[i].uncertainties_list_[j].child_ << "_pitch\" value=\"" << ypr.val[1] << "\"/>" << std::endl
-				   << "  <property name=\"" << calibration_setups_[i].uncertainties_list_[j].child_ << "_yaw\" value=\"" << ypr.val[0] << "\"/>" << std::endl
+			const std::string &parent = FrameRegistry::name(calibration_setups_[i].uncertainties_list_[j].parent_);
+			const std::string &child = FrameRegistry::name(calibration_setups_[i].uncertainties_list_[j].child_);
+
+			output << "<!-- " << child << " mount positions | camera_base_calibration | relative to " << parent << "-->" << std::endl
+				   << "  <property name=\"" << child << "_x\" value=\"" << calibration_setups_[i].uncertainties_list_[j].current_trafo_.at<double>(0,3) << "\"/>" << std::endl
+				   << "  <property name=\"" << child << "_y\" value=\"" << calibration_setups_[i].uncertainties_list_[j].current_trafo_.at<double>(1,3) << "\"/>" << std::endl
+				   << "  <property name=\"" << child << "_z\" value=\"" << calibration_setups_[i].uncertainties_list_[j].current_trafo_.at<double>(2,3) << "\"/>" << std::endl
+				   << "  <property name=\"" << child << "_roll\" value=\"" << ypr.val[2] << "\"/>" << std::endl
+				   << "  <property name=\"" << child << "_pitch\" value=\"" << ypr.val[1] << "\"/>" << std::endl
+				   << "  <property name=\"" << child << "_yaw\" value=\"" << ypr.val[0] << "\"/>" << std::endl
 				   << std::endl << std::endl;
 		}
+
+		if ( i < residual_histories_.size() && !residual_histories_[i].empty() )
+		{
+			output << "<!-- calibration setup " << (i+1) << " | " << optimization_method_ << " optimization | iterations: " << optimization_iteration_counts_[i]
+				   << " | RMS point residual per iteration [m]:";
+			for ( int k=0; k<residual_histories_[i].size(); ++k )
+				output << " " << residual_histories_[i][k];
+			output << " -->" << std::endl << std::endl << std::endl;
+		}
+
+		if ( i < configuration_inliers_.size() && !configuration_inliers_[i].empty() )
+		{
+			// snapshots loaded from disk do not know their robot configuration, they are numbered in the order they have been captured
+			const bool known_configs = ( snapshot_configs_.size() == configuration_inliers_[i].size() );
+			output << "<!-- calibration setup " << (i+1) << " | " << (known_configs ? "robot configurations" : "snapshots") << " dropped as outliers:";
+			for ( int k=0; k<configuration_inliers_[i].size(); ++k )
+				if ( !configuration_inliers_[i][k] )
+					output << " " << ((known_configs ? calibration_interface_->getScheduledIndex(snapshot_configs_[k]) : k)+1);
+			output << " -->" << std::endl << std::endl << std::endl;
+		}
 	}
 
 	std::cout << std::endl << std::endl << output.str();
@@ -814,279 +1361,226 @@ void RobotCalibration::displayAndSaveCalibrationResult()
 		ROS_WARN("RobotCalibration::displayAndSaveCalibrationResult - Not saving calibration results.");
 }
 
-bool RobotCalibration::extrinsicCalibration(const int current_setup_idx, const int current_uncertainty_idx)
+void RobotCalibration::optimizationWorker()
 {
-	CalibrationSetup &setup = calibration_setups_[current_setup_idx];
-	CalibrationInfo &current_uncertainty = setup.uncertainties_list_[current_uncertainty_idx];
-	bool on_parent_branch = current_uncertainty.parent_branch_uncertainty_;
-
-	std::vector<cv::Point3d> points_3d_uncertainty_parent;  // parent marker points in uncertainty parent frame
-	std::vector<cv::Point3d> points_3d_uncertainty_child;  // child marker points in uncertainty child frame
-
-	for ( int i=0; i<tf_snapshots_.size(); ++i )  // go through all snapshots for this setup
+	while ( true )
 	{
-		std::vector<TFInfo>* branch_tmp;  			// either parent or child_branch
-		std::vector<TFInfo>* other_branch_tmp;		// if branch = child_branch then this is parent_branch and vice versa
-		TFSnapshot &snapshot = tf_snapshots_[i][current_setup_idx];
-
-		if ( &snapshot == 0 )  // should never happen that a snapshot is empty, but just in case
-			continue;
-
-		if ( on_parent_branch )
-		{
-			branch_tmp = &snapshot.parent_branch_;
-			other_branch_tmp = &snapshot.child_branch_;
-		}
-		else
+		int group = -1;
 		{
-			branch_tmp = &snapshot.child_branch_;
-			other_branch_tmp = &snapshot.parent_branch_;
+			boost::mutex::scoped_lock lock(optimization_mutex_);
+			if ( optimization_failed_ || next_optimization_group_ >= optimization_groups_.size() )
+				return;
+			group = next_optimization_group_++;
 		}
 
-		// now with references
-		std::vector<TFInfo> &branch = *branch_tmp;
-		std::vector<TFInfo> &other_branch = *other_branch_tmp;
-
-		bool parent_markers = true;
-		std::vector<TFInfo>* otherbranch_last_to_parent_markers_tmp = getBranchEndToMarkers(current_uncertainty_idx, parent_markers, snapshot);
-		std::vector<TFInfo>* branch_last_to_child_markers_tmp = getBranchEndToMarkers(current_uncertainty_idx, !parent_markers, snapshot);
-
-		if ( branch_last_to_child_markers_tmp == 0 || otherbranch_last_to_parent_markers_tmp == 0 )
+		// setups of a group depend on each other, so they are solved one after another in their original order
+		for ( int i=0; i<optimization_groups_[group].size(); ++i )
 		{
-			ROS_WARN("RobotCalibration::extrinsicCalibration - Child or parent markers vector cannot be found in current snapshot %d, skipping", i);
-			continue;
+			if ( !ros::ok() || !optimizeSetup(optimization_groups_[group][i]) )
+			{
+				boost::mutex::scoped_lock lock(optimization_mutex_);
+				optimization_failed_ = true;
+				return;
+			}
 		}
+	}
+}
 
-		std::vector<TFInfo> &branch_last_to_child_markers = *branch_last_to_child_markers_tmp;  // vector that contains all trafos from last branch frame to child markers
-		std::vector<TFInfo> &otherbranch_last_to_parent_markers = *otherbranch_last_to_parent_markers_tmp; // vector that contains all trafos from last otherbranch frame to parent markers
+bool RobotCalibration::optimizeSetup(const int current_setup_idx)
+{
+	if ( optimization_method_.compare("joint") == 0 )
+		return jointCalibration(current_setup_idx);
 
-		if ( branch_last_to_child_markers.size() == 0 || otherbranch_last_to_parent_markers.size() == 0 )
-		{
-			ROS_WARN("RobotCalibration::extrinsicCalibration - Child or parent markers vector is empty in snapshot %d, skipping.", i);
-			continue;
-		}
+	int iterations = 0;
 
-		if ( branch_last_to_child_markers.size() != otherbranch_last_to_parent_markers.size() )
-		{
-			ROS_WARN("RobotCalibration::extrinsicCalibration - branch_to_child_markers vector and otherbranch_to_parent_markers vector do not have the same size in snapshot %d, skipping.", i);
-			continue;
-		}
+	// if there is only one trafo to calibrate, we don't need to optimize over iterations
+	if ( calibration_setups_[current_setup_idx].uncertainties_list_.size() > 1 )
+		iterations = optimization_iterations_;
+	else
+		iterations = 1;
 
-		bool success = true;
-		cv::Mat uc_to_last_branch_frame;  // uc = uncertainty child, uncertainty child to last frame on branch
-		cv::Mat up_to_origin;  // up = uncertainty parent, uncertainty parent to origin
-		cv::Mat origin_to_last_otherbranch_frame;  // origin to last frame on other-branch
+	std::vector<transform_utilities::RigidTransform> previous_trafos;
+	for (int i=0; i<iterations; ++i)
+	{
+		compiled_snapshots_.getUncertaintyTrafos(current_setup_idx, previous_trafos);
+		configuration_inliers_[current_setup_idx].clear();  // refilled by extrinsicCalibration during robust estimation
 
-		// build transform chains
-		if ( branch.size() > 0 )
+		for ( int j=0; j<calibration_setups_[current_setup_idx].uncertainties_list_.size(); ++j )
 		{
-			TFInfo last_trafo = branch[branch.size()-1];
-			success &= buildTransformChain(current_uncertainty.child_, last_trafo.child_, branch, uc_to_last_branch_frame);
+			if ( !ros::ok() || !extrinsicCalibration(current_setup_idx, j) )
+				return false;
 		}
-		else
-			uc_to_last_branch_frame = cv::Mat::eye(4,4,CV_64FC1);  // identity -> has no effect on transformation chain
-
-		success &= buildTransformChain(current_uncertainty.parent_, setup.origin_, branch, up_to_origin);
 
-		if ( other_branch.size() > 0 )
-		{
-			TFInfo last_trafo = other_branch[other_branch.size()-1];
-			success &= buildTransformChain(setup.origin_, last_trafo.child_, other_branch, origin_to_last_otherbranch_frame);
-		}
-		else
-			origin_to_last_otherbranch_frame = cv::Mat::eye(4,4,CV_64FC1);
+		optimization_iteration_counts_[current_setup_idx] = i+1;
+		residual_histories_[current_setup_idx].push_back(computeRMSResidual(current_setup_idx));
 
-		if ( !success )
-		{
-			ROS_ERROR("RobotCalibration::extrinsicCalibration - Failed to build one or more necessary transforms, skipping snapshot %d.", i);
-			continue;
-		}
-
-		// build marker points for extrinsic calibration of uncertainty parent
-		cv::Mat up_to_last_otherbranch_frame = up_to_origin * origin_to_last_otherbranch_frame;
-		for ( int j=0; j<otherbranch_last_to_parent_markers.size(); ++j )
-		{
-			std::string parent_marker_frame = otherbranch_last_to_parent_markers[j].child_;
-			std::vector<cv::Point3f> pattern_points_3d;
-			calibration_interface_->getPatternPoints3D(parent_marker_frame, pattern_points_3d);  // get pattern points of current marker
-			cv::Mat uncertainty_parent_to_marker = up_to_last_otherbranch_frame * otherbranch_last_to_parent_markers[j].transform_;
+		// stop as soon as another sweep would not change the result anymore
+		if ( i > 0 && hasConverged(current_setup_idx, previous_trafos) )
+			break;
+	}
 
-			for ( int k=0; k<pattern_points_3d.size(); ++k )
-			{
-				cv::Mat marker_point = cv::Mat(cv::Vec4d(pattern_points_3d[k].x, pattern_points_3d[k].y, pattern_points_3d[k].z, 1.0));
-				cv::Mat point_parent = uncertainty_parent_to_marker * marker_point;
-				points_3d_uncertainty_parent.push_back( cv::Point3d(point_parent.at<double>(0), point_parent.at<double>(1), point_parent.at<double>(2)) );
-			}
-		}
+	std::cout << "Calibration setup " << (current_setup_idx+1) << ": alternating optimization finished after " << optimization_iteration_counts_[current_setup_idx]
+			  << " iterations, RMS point residual: " << residual_histories_[current_setup_idx].back() << std::endl;
 
-		// build marker points for extrinsic calibration of uncertainty child
-		for ( int j=0; j<branch_last_to_child_markers.size(); ++j )
-		{
-			std::string child_marker_frame = branch_last_to_child_markers[j].child_;
-			std::vector<cv::Point3f> pattern_points_3d;
-			calibration_interface_->getPatternPoints3D(child_marker_frame, pattern_points_3d);  // get pattern points of current marker
-			cv::Mat uncertainty_child_to_marker = uc_to_last_branch_frame * branch_last_to_child_markers[j].transform_;
+	const std::vector<bool> &inliers = configuration_inliers_[current_setup_idx];
+	if ( std::count(inliers.begin(), inliers.end(), false) > 0 )
+		std::cout << "Calibration setup " << (current_setup_idx+1) << ": " << std::count(inliers.begin(), inliers.end(), false) << " of " << inliers.size()
+				  << " robot configurations have been dropped as outliers." << std::endl;
+	return true;
+}
 
-			for ( int k=0; k<pattern_points_3d.size(); ++k )
-			{
-				cv::Mat marker_point = cv::Mat(cv::Vec4d(pattern_points_3d[k].x, pattern_points_3d[k].y, pattern_points_3d[k].z, 1.0));
-				cv::Mat point_child = uncertainty_child_to_marker * marker_point;
-				points_3d_uncertainty_child.push_back( cv::Point3d(point_child.at<double>(0), point_child.at<double>(1), point_child.at<double>(2)) );
-			}
-		}
+bool RobotCalibration::extrinsicCalibration(const int current_setup_idx, const int current_uncertainty_idx)
+{
+	// marker points of parent markers in uncertainty parent frame and of child markers in uncertainty child frame
+	const std::vector<cv::Point3d> *points_3d_uncertainty_parent = 0;
+	const std::vector<cv::Point3d> *points_3d_uncertainty_child = 0;
+	const std::vector<int> *snapshot_begin = 0;
+	const std::vector<double> *weights = 0;  // correspondences of steadily detected markers weigh more
+	if ( !compiled_snapshots_.collectPoints(current_setup_idx, current_uncertainty_idx, points_3d_uncertainty_parent, points_3d_uncertainty_child, snapshot_begin, weights) )
+	{
+		ROS_ERROR("RobotCalibration::extrinsicCalibration - Invalid calibration setup %d or uncertainty %d.", current_setup_idx, current_uncertainty_idx);
+		return false;
 	}
 
-	if ( points_3d_uncertainty_parent.size() == 0 || points_3d_uncertainty_child.size() == 0 )
+	const CalibrationInfo &current_uncertainty = calibration_setups_[current_setup_idx].uncertainties_list_[current_uncertainty_idx];
+
+	if ( points_3d_uncertainty_parent->size() == 0 || points_3d_uncertainty_child->size() == 0 )
 	{
-		ROS_ERROR("RobotCalibration::extrinsicCalibration - One uncertainty points vector is empty, transform from %s to %s not calibrated, skipping uncertainty!", current_uncertainty.parent_.c_str(), current_uncertainty.child_.c_str());
+		ROS_ERROR("RobotCalibration::extrinsicCalibration - One uncertainty points vector is empty, transform from %s to %s not calibrated, skipping uncertainty!", FrameRegistry::name(current_uncertainty.parent_).c_str(), FrameRegistry::name(current_uncertainty.child_).c_str());
 		return false;
 	}
 
 	// compute extrinsic transform
-	if ( points_3d_uncertainty_parent.size() == points_3d_uncertainty_child.size() )
+	if ( points_3d_uncertainty_parent->size() == points_3d_uncertainty_child->size() )
 	{
-		current_uncertainty.current_trafo_ = transform_utilities::computeExtrinsicTransform(points_3d_uncertainty_parent, points_3d_uncertainty_child);
-		current_uncertainty.calibrated_ = true;  // uncertainty has been calibrated, this flag leads to that snapshotted TF values won't be used anymore
+		transform_utilities::RigidTransform trafo;
+		if ( robust_estimation_ )
+		{
+			// snapshots that do not agree with the consensus are dropped, a robot configuration is an inlier if it agrees for every uncertainty
+			std::vector<bool> snapshot_inliers;
+			if ( !transform_utilities::computeRobustExtrinsicTransform(*points_3d_uncertainty_parent, *points_3d_uncertainty_child, *snapshot_begin, robust_loss_,
+																		robust_inlier_threshold_, ransac_hypotheses_, trafo, snapshot_inliers, weights) )
+			{
+				ROS_ERROR("RobotCalibration::extrinsicCalibration - Robust estimation failed, transform from %s to %s not calibrated, skipping uncertainty!", FrameRegistry::name(current_uncertainty.parent_).c_str(), FrameRegistry::name(current_uncertainty.child_).c_str());
+				return false;
+			}
+
+			std::vector<bool> &configuration_inliers = configuration_inliers_[current_setup_idx];
+			if ( configuration_inliers.empty() )
+				configuration_inliers.assign(snapshot_inliers.size(), true);
+			for ( int i=0; i<snapshot_inliers.size() && i<configuration_inliers.size(); ++i )
+				if ( (*snapshot_begin)[i+1] > (*snapshot_begin)[i] && !snapshot_inliers[i] )  // configurations without markers of this uncertainty are not judged
+					configuration_inliers[i] = false;
+		}
+		else
+		{
+			transform_utilities::ExtrinsicAccumulator accumulator;
+			for ( int i=0; i<points_3d_uncertainty_parent->size(); ++i )
+				accumulator.add((*points_3d_uncertainty_parent)[i], (*points_3d_uncertainty_child)[i], (*weights)[i]);
+			accumulator.computeTransform(trafo);
+		}
+
+		// uncertainty is marked calibrated, this leads to that snapshotted TF values won't be used for it anymore
+		compiled_snapshots_.updateUncertainty(current_setup_idx, current_uncertainty_idx, trafo);
 		return true;
 	}
 	else
 	{
-		ROS_ERROR("RobotCalibration::extrinsicCalibration - Uncertainty points vectors do not have same size, transform from %s to %s not calibrated, skipping uncertainty!", current_uncertainty.parent_.c_str(), current_uncertainty.child_.c_str());
+		ROS_ERROR("RobotCalibration::extrinsicCalibration - Uncertainty points vectors do not have same size, transform from %s to %s not calibrated, skipping uncertainty!", FrameRegistry::name(current_uncertainty.parent_).c_str(), FrameRegistry::name(current_uncertainty.child_).c_str());
 	}
 
 	return false;
 }
 
-std::vector<TFInfo>* RobotCalibration::getBranchEndToMarkers(const int uncertainty_index, const bool parent_markers, TFSnapshot &snapshot)
+bool RobotCalibration::jointCalibration(const int current_setup_idx)
 {
-	for ( int i=0; i<snapshot.branch_ends_to_markers_.size(); ++i )
+	cv::Mat JtJ, Jtr, A, delta;
+	std::vector<transform_utilities::RigidTransform> previous_trafos;
+	int residual_count = 0;
+	double lambda = 1e-3;  // Levenberg-Marquardt damping
+
+	double cost = compiled_snapshots_.evaluateSetup(current_setup_idx, &JtJ, &Jtr, residual_count);
+	if ( residual_count == 0 )
 	{
-		if ( snapshot.branch_ends_to_markers_[i].corresponding_uncertainty_idx_ == uncertainty_index )  // snapshot entry found for our uncertainty
-		{
-			if ( parent_markers )
-				return &snapshot.branch_ends_to_markers_[i].otherbranch_to_parent_markers_;
-			else
-				return &snapshot.branch_ends_to_markers_[i].branch_to_child_markers_;
-		}
+		ROS_ERROR("RobotCalibration::jointCalibration - No marker points available for calibration setup %d.", current_setup_idx+1);
+		return false;
 	}
 
-	return 0;
-}
-
-bool RobotCalibration::buildTransformChain(const std::string start, const std::string end, const std::vector<TFInfo> &branch, cv::Mat &trafo)  // get transform chain
-{
-	// start and end are not necessarily next to one another
-	int start_idx = -1;
-	int end_idx = -1;
-
-	std::vector<std::string> branch_chain;  // consecutive chain of transforms instead of parent and child
-	branch_chain.reserve(branch.size()+1);
-	for ( int i=0; i<branch.size(); ++i )
-		branch_chain.push_back(branch[i].parent_);
-
-	if ( branch.size() > 0 )  // add last child
-		branch_chain.push_back(branch[branch.size()-1].child_);
-
-	for ( int i=0; i<branch_chain.size(); ++i )  // find indexes of start and end point
+	const double initial_rms = std::sqrt(cost/residual_count);
+	residual_histories_[current_setup_idx].push_back(initial_rms);
+	int iteration = 0;
+	for ( ; iteration<optimization_iterations_; ++iteration )
 	{
-		if ( start_idx == -1 && start.compare(branch_chain[i]) == 0 )
-			start_idx = i;
+		if ( !ros::ok() )
+			return false;
 
-		if ( end_idx == -1 && end.compare(branch_chain[i]) == 0 )
-			end_idx = i;
+		// solve damped normal equations (JtJ + lambda*diag(JtJ)) * delta = -Jtr
+		A = JtJ.clone();
+		for ( int i=0; i<A.rows; ++i )
+			A.at<double>(i,i) += lambda*A.at<double>(i,i) + 1e-12;
 
-		if ( start_idx != -1 && end_idx != -1 )  // indexes found, exit loop
-			break;
-	}
+		if ( !cv::solve(A, -Jtr, delta, cv::DECOMP_CHOLESKY) )
+		{
+			lambda *= 10.;
+			continue;
+		}
 
-	if ( start_idx < 0 || end_idx < 0 )  // invalid index
-	{
-		ROS_ERROR("RobotCalibration::buildTransformChain - Could not build transform chain from %s to %s in current snapshot", start.c_str(), end.c_str());
-		return false;
-	}
-	else if ( start_idx < end_idx )  // normal forward transform
-	{
-		for ( int i=start_idx; i<end_idx; ++i )  // retrieve trafo from start_idx to end_idx one by one
+		compiled_snapshots_.getUncertaintyTrafos(current_setup_idx, previous_trafos);
+		compiled_snapshots_.applyIncrement(current_setup_idx, delta);
+
+		int count = 0;
+		const double new_cost = compiled_snapshots_.evaluateSetup(current_setup_idx, 0, 0, count);
+		if ( new_cost < cost )  // accept step
 		{
-			cv::Mat temp;
+			const bool converged = ( cost-new_cost < 1e-12*cost || cv::norm(delta) < 1e-10 );
+			cost = compiled_snapshots_.evaluateSetup(current_setup_idx, &JtJ, &Jtr, residual_count);
+			lambda = std::max(lambda*0.1, 1e-10);
+			residual_histories_[current_setup_idx].push_back(std::sqrt(cost/residual_count));
 
-			if ( retrieveTransform(branch_chain[i], branch_chain[i+1], branch, temp) )
-			{
-				if ( trafo.empty() )
-					trafo = temp;
-				else
-					trafo *= temp;
-			}
-			else
-				return false;
+			if ( converged )
+				break;
 		}
-	}
-	else if ( start_idx > end_idx )  // return inverse
-	{
-		for ( int i=start_idx; i>end_idx; --i )  // retrieve trafo from end_idx to start_idx one by one
+		else  // reject step and increase damping
 		{
-			cv::Mat temp;
+			compiled_snapshots_.setUncertaintyTrafos(current_setup_idx, previous_trafos);
+			lambda *= 10.;
 
-			if ( retrieveTransform(branch_chain[i], branch_chain[i-1], branch, temp) )
-			{
-				if ( trafo.empty() )
-					trafo = temp;
-				else
-					trafo *= temp;
-			}
-			else
-				return false;
+			if ( lambda > 1e10 )  // no further improvement possible
+				break;
 		}
 	}
-	else  // start_idx == end_idx -> return identity matrix
-	{
-		trafo = cv::Mat::eye(4,4,CV_64FC1);
-	}
 
-	return !trafo.empty();
+	optimization_iteration_counts_[current_setup_idx] = std::min(iteration+1, optimization_iterations_);
+	std::cout << "Calibration setup " << (current_setup_idx+1) << ": joint optimization finished after " << optimization_iteration_counts_[current_setup_idx]
+			  << " iterations, RMS point residual: " << initial_rms << " -> " << std::sqrt(cost/residual_count) << std::endl;
+	return true;
 }
 
-bool RobotCalibration::retrieveTransform(const std::string parent, const std::string child, const std::vector<TFInfo> &branch, cv::Mat &trafo)  // get the next trafo
+bool RobotCalibration::hasConverged(const int current_setup_idx, const std::vector<transform_utilities::RigidTransform> &previous_trafos)
 {
-	// search whether it is a uncertainty and if it is calibrated. in that case return it instead of what's in the snapshot
-	for ( int i=0; i<calibration_setups_.size(); ++i )
-	{
-		for ( int j=0; j<calibration_setups_[i].uncertainties_list_.size(); ++j )
-		{
-			CalibrationInfo &uncertainty = calibration_setups_[i].uncertainties_list_[j];
+	const std::vector<double> &history = residual_histories_[current_setup_idx];
+	if ( history.size() < 2 || std::fabs(history[history.size()-1] - history[history.size()-2]) > convergence_residual_threshold_ )
+		return false;
 
-			if ( uncertainty.calibrated_ )
-			{
-				if ( uncertainty.child_.compare(child) == 0 && uncertainty.parent_.compare(parent) == 0 )
-				{
-					trafo = calibration_setups_[i].uncertainties_list_[j].current_trafo_.clone();
-					return true;
-				}
-				else if ( uncertainty.child_.compare(parent) == 0 && uncertainty.parent_.compare(child) == 0 )  // return inverse
-				{
-					trafo = calibration_setups_[i].uncertainties_list_[j].current_trafo_.inv();
-					return true;
-				}
-			}
-		}
-	}
+	std::vector<transform_utilities::RigidTransform> current_trafos;
+	compiled_snapshots_.getUncertaintyTrafos(current_setup_idx, current_trafos);
+	if ( current_trafos.size() != previous_trafos.size() )
+		return false;
 
-	// in a second step search through the snapshotted branch and return the corresponding transform
-	for ( int i=0; i<branch.size(); ++i )
+	for ( int j=0; j<current_trafos.size(); ++j )
 	{
-		if ( branch[i].child_.compare(child) == 0 && branch[i].parent_.compare(parent) == 0 )  // in right order
-		{
-			trafo = branch[i].transform_.clone();
-			return true;
-		}
-		else if ( branch[i].child_.compare(parent) == 0 && branch[i].parent_.compare(child) == 0 )  // order swapped -> inverse
-		{
-			trafo = branch[i].transform_.inv();
-			return true;
-		}
+		double translation_delta = 0.0, rotation_delta = 0.0;
+		transform_utilities::transformDifference(previous_trafos[j], current_trafos[j], translation_delta, rotation_delta);
+		if ( translation_delta > convergence_translation_threshold_ || rotation_delta > convergence_rotation_threshold_ )
+			return false;
 	}
 
-	ROS_ERROR("RobotCalibration::retrieveTransform - Could not retrieve transform from %s to %s in current snapshot", parent.c_str(), child.c_str());
-	return false;
+	return true;
 }
 
+double RobotCalibration::computeRMSResidual(const int current_setup_idx)
+{
+	int residual_count = 0;
+	const double cost = compiled_snapshots_.evaluateSetup(current_setup_idx, 0, 0, residual_count);
+	return ( residual_count > 0 ? std::sqrt(cost/residual_count) : 0.0 );
+}